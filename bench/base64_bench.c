@@ -0,0 +1,179 @@
+/*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
+
+/*
+ * Compares son_local_base64_encode() with the encoder that son.c used
+ * before son_base64.c (copied below as old_base64_encode()).
+ *
+ * Build on a POSIX host from the top of the repository (the vector
+ * encoders are selected with the target flags, e.g. -mssse3 or -mavx2):
+ *
+ * gcc -O2 [-mssse3|-mavx2] -Iinclude -Isrc bench/base64_bench.c src/son_base64.c -o base64_bench
+ * ./base64_bench [size ...]
+ *
+ * Each size is encoded until 64MB of input have been processed. The
+ * output of both encoders is compared before timing.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "son_local.h"
+
+#define BENCH_TOTAL_BYTES (64UL*1024*1024)
+
+static int old_base64_encode(char * dest, const void * src, int nbyte);
+static char old_base64_encode_six(uint8_t six_bit_value);
+static double bench_seconds();
+static int bench_size(int nbyte);
+
+int main(int argc, char * argv[]){
+	static const int sizes[] = { 48, 1024, 65536 };
+	int i;
+
+	printf("%-8s %-12s %-12s %s\n", "bytes", "old MB/s", "new MB/s", "speedup");
+	if( argc > 1 ){
+		for(i=1; i < argc; i++){
+			if( bench_size(atoi(argv[i])) < 0 ){
+				return 1;
+			}
+		}
+	} else {
+		for(i=0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++){
+			if( bench_size(sizes[i]) < 0 ){
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int bench_size(int nbyte){
+	u8 * src;
+	char * old_dest;
+	char * new_dest;
+	volatile son_size_t sink = 0;
+	double start;
+	double old_time;
+	double new_time;
+	int reps;
+	int i;
+
+	if( nbyte <= 0 ){
+		return -1;
+	}
+
+	//the old encoder reads up to 2 bytes past the end of the input
+	src = malloc(nbyte + 2);
+	old_dest = malloc(nbyte*2 + 8);
+	new_dest = malloc(nbyte*2 + 8);
+	if( (src == 0) || (old_dest == 0) || (new_dest == 0) ){
+		return -1;
+	}
+
+	srand(nbyte);
+	for(i=0; i < nbyte; i++){
+		src[i] = rand();
+	}
+	src[nbyte] = 0;
+	src[nbyte+1] = 0;
+
+	old_base64_encode(old_dest, src, nbyte);
+	new_dest[son_local_base64_encode(new_dest, src, nbyte)] = 0;
+	if( strcmp(old_dest, new_dest) != 0 ){
+		printf("%-8d output doesn't match\n", nbyte);
+		return -1;
+	}
+
+	reps = BENCH_TOTAL_BYTES / nbyte;
+
+	start = bench_seconds();
+	for(i=0; i < reps; i++){
+		sink += old_base64_encode(old_dest, src, nbyte);
+	}
+	old_time = bench_seconds() - start;
+
+	start = bench_seconds();
+	for(i=0; i < reps; i++){
+		sink += son_local_base64_encode(new_dest, src, nbyte);
+	}
+	new_time = bench_seconds() - start;
+
+	printf("%-8d %-12.1f %-12.1f %.1fx\n",
+			nbyte,
+			(double)reps*nbyte/old_time/1e6,
+			(double)reps*nbyte/new_time/1e6,
+			old_time/new_time);
+
+	free(src);
+	free(old_dest);
+	free(new_dest);
+	return 0;
+}
+
+double bench_seconds(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+//the encoder as it was in son.c
+int old_base64_encode(char * dest, const void * src, int nbyte){
+	int i;
+	int j;
+	int k;
+	int len;
+	uint8_t six_bits[4];
+	len = nbyte;
+	const char * data;
+	data = (const char *)src;
+
+	k = 0;
+	//We need to encode three bytes at a time in to four encoded bytes
+	for(i=0; i < len; i+=3){
+		//First the thress bytes are broken down into six-bit sections
+		six_bits[0] = (data[i] >> 2) & 0x3F;
+		six_bits[1] = ((data[i] << 4) & 0x30) + ((data[i+1]>>4) & 0x0F);
+		six_bits[2] = ((data[i+1] << 2) & 0x3C) + ((data[i+2]>>6) & 0x03);
+		six_bits[3] = data[i+2] & 0x3F;
+		//now we use the helper function to convert from six-bits to base64
+		for(j=0; j < 4; j++){
+			dest[k+j] = old_base64_encode_six(six_bits[j]);
+		}
+		k+=4;
+	}
+
+	//at the end, we add = if the input is not divisible by 3
+	if( (len % 3) == 1 ){
+		//two equals at end
+		dest[k-2] = '=';
+		dest[k-1] = '=';
+	} else if ( (len %3 ) == 2 ){
+		dest[k-1] = '=';
+	}
+
+	//finally, zero terminate the output string
+	dest[k] = 0;
+
+	return strlen(dest);
+}
+
+//This is a helper function to convert a six-bit value to base64
+char old_base64_encode_six(uint8_t six_bit_value){
+	uint8_t x;
+	char c = -1;
+	x = six_bit_value & ~0xC0; //remove top two bits (should be zero anyway)
+	if( x < 26 ){
+		c = 'A' + x;
+	} else if ( x < 52 ){
+		c = 'a' + (x - 26);
+	} else if( x < 62 ){
+		c = '0' + (x - 52);
+	} else if( x == 62 ){
+		c = '+';
+	} else if (x == 63 ){
+		c = '/';
+	}
+	return c;
+}
@@ -0,0 +1,178 @@
+/*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
+
+/*
+ * Measures how long son_recv_message() takes to return a message after
+ * it is sent on a local pipe (or a pty with the "pty" argument).
+ *
+ * A thread sends one message every few milliseconds so the receiver is
+ * always waiting when the message arrives. The latency is the time from
+ * just before son_send_message() until son_recv_message() returns. The
+ * read side is non-blocking so the receive waits in
+ * son_phy_wait_fileno() (poll() on POSIX hosts).
+ *
+ * Build on a POSIX host from the top of the repository (son_message.c
+ * includes <sos/dev/cfifo.h> from the Stratify SDK):
+ *
+ * gcc -O2 -Iinclude -I<sdk>/include bench/message_latency.c src/son*.c -o message_latency -lpthread
+ * ./message_latency [pty] [count]
+ *
+ * The sleep based wait that poll() replaced can't be rebuilt this way:
+ * before that change son_phy_read_fileno() only read through the link
+ * driver, so the receive never sees data on a host pipe.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "son.h"
+
+#define BENCH_MESSAGE_MAX 1000
+#define BENCH_MESSAGE_SIZE 256
+
+typedef struct {
+	int fd;
+	int count;
+	double sent_at[BENCH_MESSAGE_MAX];
+} bench_sender_t;
+
+static void * bench_send(void * args);
+static int bench_open_pty(int * write_fd, int * read_fd);
+static double bench_ms();
+
+int main(int argc, char * argv[]){
+	static char buffer[BENCH_MESSAGE_SIZE];
+	static bench_sender_t sender;
+	pthread_t thread;
+	son_t h;
+	int fd[2];
+	int is_pty = 0;
+	int received = 0;
+	double latency;
+	double total = 0.0;
+	double worst = 0.0;
+	int i;
+
+	sender.count = 20;
+	for(i=1; i < argc; i++){
+		if( strcmp(argv[i], "pty") == 0 ){
+			is_pty = 1;
+		} else {
+			sender.count = atoi(argv[i]);
+		}
+	}
+	if( (sender.count <= 0) || (sender.count > BENCH_MESSAGE_MAX) ){
+		printf("count must be 1 to %d\n", BENCH_MESSAGE_MAX);
+		return 1;
+	}
+
+	if( is_pty ){
+		if( bench_open_pty(&fd[1], &fd[0]) < 0 ){
+			printf("failed to open a pty\n");
+			return 1;
+		}
+	} else if( pipe(fd) < 0 ){
+		printf("failed to create a pipe\n");
+		return 1;
+	}
+	fcntl(fd[0], F_SETFL, O_NONBLOCK);
+
+	sender.fd = fd[1];
+	pthread_create(&thread, 0, bench_send, &sender);
+
+	for(i=0; i < sender.count; i++){
+		memset(&h, 0, sizeof(h));
+		son_open_message(&h, buffer, sizeof(buffer));
+		while( son_recv_message(&h, fd[0], 1000) <= 0 ){
+			;
+		}
+		latency = bench_ms() - sender.sent_at[i];
+		total += latency;
+		if( latency > worst ){
+			worst = latency;
+		}
+		if( son_read_num(&h, "index") == i ){
+			received++;
+		}
+		son_close(&h);
+	}
+
+	pthread_join(thread, 0);
+
+	printf("%s: %d/%d received, mean latency %.3f ms, worst %.3f ms\n",
+			is_pty ? "pty" : "pipe",
+			received,
+			sender.count,
+			total / sender.count,
+			worst);
+
+	return received != sender.count;
+}
+
+void * bench_send(void * args){
+	static char buffer[BENCH_MESSAGE_SIZE];
+	bench_sender_t * sender = args;
+	son_stack_t stack[4];
+	son_t h;
+	int i;
+
+	for(i=0; i < sender->count; i++){
+		//give the receiver time to start waiting
+		usleep(7000);
+
+		memset(&h, 0, sizeof(h));
+		son_create_message(&h, buffer, sizeof(buffer), stack, 4);
+		son_open_object(&h, "");
+		son_write_num(&h, "index", i);
+		son_write_str(&h, "text", "hello");
+		son_close(&h);
+
+		son_open_message(&h, buffer, sizeof(buffer));
+		sender->sent_at[i] = bench_ms();
+		if( son_send_message(&h, sender->fd, 1000) < 0 ){
+			printf("failed to send message %d\n", i);
+		}
+		son_close(&h);
+	}
+	return 0;
+}
+
+int bench_open_pty(int * write_fd, int * read_fd){
+	struct termios attr;
+	int master;
+	int slave;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if( (master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0) ){
+		return -1;
+	}
+
+	slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if( slave < 0 ){
+		return -1;
+	}
+
+	//raw mode so the binary frames pass through unchanged
+	tcgetattr(slave, &attr);
+	cfmakeraw(&attr);
+	tcsetattr(slave, TCSANOW, &attr);
+
+	*write_fd = master;
+	*read_fd = slave;
+	return 0;
+}
+
+double bench_ms(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1e3 + t.tv_nsec/1e6;
+}
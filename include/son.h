@@ -113,15 +113,29 @@ typedef enum {
 	SON_ERR_MESSAGE_IO /*! 21: This happens when there is an error trying to read or write the message to a device or file. */,
 	SON_ERR_NO_MESSAGE /*! 22: This happens when trying to send/receive a message using a handle that is not associated with a message. */,
 	SON_ERR_INCOMPLETE_MESSAGE /*! 23: This happens when trying to send a message or get the size of the message when it is will open for editing/writing. */,
-	SON_ERR_NO_CHILDREN /*! 24: This happens when seeking the next children if the type is not an object or array. */
+	SON_ERR_NO_CHILDREN /*! 24: This happens when seeking the next children if the type is not an object or array. */,
+	SON_ERR_INVALID_CACHE /*! 25: This happens when the cache passed to son_set_cache() (or the buffer passed to son_set_write_buffer()) is invalid or can't be attached to the handle. */,
+	SON_ERR_INVALID_ACCESS /*! 26: This happens when the \a access parameter is not formatted correctly (e.g. "array[x]"). */,
+	SON_ERR_FILE_TOO_LARGE /*! 27: This happens when a document grows past the 16MB limit of the compact format (see SON_FLAG_LARGE). */,
+	SON_ERR_JSON_SYNTAX /*! 28: This happens when son_from_json() reads text that is not valid JSON. */,
+	SON_ERR_DOCUMENT_CRC /*! 29: This happens when son_verify() is used on a document that doesn't have a CRC (see SON_FLAG_CRC) or the CRC doesn't match. */,
+	SON_ERR_RING_FULL /*! 30: This happens when son_create_ring_message() is called and all the slots of the ring are in use. */,
+	SON_ERR_DOCUMENT_CLOSED /*! 31: This happens when son_open_doc() is called on a document that was closed with son_doc_close() and has no handles left. */
 } son_err_t;
 
 #define SON_STR_VERSION "0.5"
 #define SON_VERSION 0x0005
 #include "son_phy.h"
 
-/*! \brief SON Size Type */
+/*! \brief SON Size Type
+ * \details Sizes and offsets are 64-bit on hosts so that
+ * large documents (see SON_FLAG_LARGE) can be handled.
+ */
+#if defined __StratifyOS__
 typedef u32 son_size_t;
+#else
+typedef u64 son_size_t;
+#endif
 
 /*! \brief Defines the maximum length of any given key
  * value. Values that exceed this length will
@@ -149,9 +163,26 @@ typedef enum {
 	SON_TRUE /*! True value (Internal use only) */,
 	SON_FALSE /*! False value (Internal use only) */,
 	SON_NULL /*! Null value (Internal use only) */,
+	SON_TYPED_ARRAY /*! Packed array of numbers that all have the same type (Internal use only) */,
+	SON_NUMBER_S64 /*! Signed 64-bit value (Internal use only) */,
+	SON_NUMBER_U64 /*! Unsigned 64-bit value (Internal use only) */,
+	SON_DOUBLE /*! Double (Internal use only) */,
 	SON_TOTAL
 } son_value_t;
 
+/*! \details Lists the element types of packed
+ * typed arrays (see son_write_array_u32()).
+ */
+typedef enum {
+	SON_ARRAY_U8 /*! Unsigned 8-bit elements */,
+	SON_ARRAY_S16 /*! Signed 16-bit elements */,
+	SON_ARRAY_U32 /*! Unsigned 32-bit elements */,
+	SON_ARRAY_S32 /*! Signed 32-bit elements */,
+	SON_ARRAY_FLOAT /*! Single precision floating point elements */,
+	SON_ARRAY_DOUBLE /*! Double precision floating point elements */,
+	SON_ARRAY_TOTAL
+} son_array_type_t;
+
 #define SON_OBJ SON_OBJECT
 
 /*! \details Defines the stack used when
@@ -167,6 +198,119 @@ typedef struct {
 } son_stack_t;
 
 
+/*! \details Defines the minimum number of members an
+ * object needs before a key index is written (see SON_FLAG_INDEX_OBJECTS).
+ *
+ * \showinitializer
+ */
+#if !defined SON_INDEX_MIN_COUNT
+#define SON_INDEX_MIN_COUNT 8
+#endif
+
+/*! \details Defines the number of array elements between
+ * entries in an array offset table (see SON_FLAG_INDEX_ARRAYS).
+ *
+ * A stride of 1 stores the offset of every element (4 bytes each) so
+ * any element is found with one table read. Larger values make the table
+ * smaller but readers then walk up to (stride - 1) elements.
+ *
+ * \showinitializer
+ */
+#if !defined SON_INDEX_ARRAY_STRIDE
+#define SON_INDEX_ARRAY_STRIDE 1
+#endif
+
+/*! \details Defines the size of the buffer son_to_json()
+ * uses to collect output. The callback (or file) receives
+ * chunks of up to this many bytes. The buffer is on the stack and
+ * must be at least 64 bytes.
+ *
+ * \showinitializer
+ */
+#if !defined SON_JSON_BUFFER_SIZE
+#if defined __StratifyOS__
+#define SON_JSON_BUFFER_SIZE 256
+#else
+#define SON_JSON_BUFFER_SIZE 4096
+#endif
+#endif
+
+/*! \details Defines the deepest nesting of objects and arrays
+ * that son_to_json() can convert. The traversal state is kept
+ * in a fixed array on the stack (rather than by recursion) so stack
+ * usage does not grow with the depth of the document. Exceeding
+ * the limit causes son_to_json() to fail with SON_ERR_STACK_OVERFLOW.
+ *
+ * \showinitializer
+ */
+#if !defined SON_JSON_DEPTH_MAX
+#if defined __StratifyOS__
+#define SON_JSON_DEPTH_MAX 16
+#else
+#define SON_JSON_DEPTH_MAX 64
+#endif
+#endif
+
+/*! \details Defines how many bytes of a string or data value
+ * son_to_json() reads at a time. Values of any size are converted
+ * using a fixed amount of memory. This must be a multiple of 3 so
+ * that base64 encoded chunks join without padding.
+ *
+ * \showinitializer
+ */
+#if !defined SON_JSON_CHUNK_SIZE
+#define SON_JSON_CHUNK_SIZE 48
+#endif
+
+/*! \details Enables the handle checksum. When enabled, every call
+ * verifies that the handle wasn't modified outside of the library
+ * (see SON_ERR_HANDLE_CHECKSUM) and updates the checksum before
+ * returning. Define this as 0 to remove the checks (e.g. in release builds).
+ *
+ * The checksum is only available on Stratify OS. The option only changes
+ * the library code: son_t keeps its checksum member either way so that an
+ * application and a library built with different values agree on the layout.
+ *
+ * \showinitializer
+ */
+#if !defined SON_HANDLE_CHECKSUM
+#if defined __StratifyOS__
+#define SON_HANDLE_CHECKSUM 1
+#else
+#define SON_HANDLE_CHECKSUM 0
+#endif
+#endif
+
+/*! \details Lists the options that can be enabled
+ * on a handle using son_set_flags().
+ *
+ */
+typedef enum {
+	SON_FLAG_INDEX_OBJECTS = (1<<0) /*! When an object with many members is closed, write a key index so members can be found without scanning */,
+	SON_FLAG_INDEX_ARRAYS = (1<<1) /*! When an array with many elements is closed, write an offset table so elements can be found without walking the array */,
+	SON_FLAG_LARGE = (1<<2) /*! Use the large document format (64-bit offsets) so the document can grow past 16MB */,
+	SON_FLAG_JSON_COMPACT = (1<<3) /*! son_to_json() leaves out the indentation and line breaks */,
+	SON_FLAG_JSON_DATA = (1<<4) /*! son_from_json() saves base64 strings that end with '=' padding as decoded data */,
+	SON_FLAG_CRC = (1<<5) /*! Store a CRC32C of the whole document so it can be checked once with son_verify() (done automatically when a document in memory is opened) */
+} son_flags_t;
+
+/*! \details Defines a document that is loaded once and
+ * shared (read only) by any number of handles.
+ *
+ * The members are managed by son_doc_open(), son_doc_open_message(),
+ * son_doc_close() and son_open_doc() and are not used in the API.
+ *
+ * The structure is not packed so that \a ref_count is aligned for the
+ * atomic operations that update it.
+ *
+ * \sa son_open_doc()
+ */
+typedef struct {
+	volatile u32 ref_count /* Internal use only */;
+	u32 o_flags /* Internal use only */;
+	son_phy_t phy /* Internal use only */;
+} son_doc_t;
+
 /*!
  * \details Defines the data type for handling files.
  *
@@ -186,13 +330,13 @@ typedef struct {
  */
 typedef struct MCU_PACK {
 	son_phy_t phy /* Internal use only */;
+	son_doc_t * doc /* Internal use only */;
 	son_stack_t * stack /* Internal use only */;
 	u16 stack_size /* Internal use only */;
 	u16 stack_loc /* Internal use only */;
 	u32 err /* Internal use only */;
-#if defined __StratifyOS__
-	u32 checksum;
-#endif
+	u32 o_flags /* Internal use only */;
+	u32 checksum /* Internal use only (always present, see SON_HANDLE_CHECKSUM) */;
 } son_t;
 
 #ifdef __cplusplus
@@ -297,6 +441,166 @@ int son_send_message(son_t * h, int fd, int timeout);
  */
 int son_recv_message(son_t * h, int fd, int timeout);
 
+/*! \details Sends a group of messages on the specified file descriptor.
+ *
+ * @param h An array of handles (each opened with son_open_message())
+ * @param count The number of handles in \a h
+ * @param fd The file descriptor to write to
+ * @param timeout The max milliseconds to block between bytes before aborting
+ * @return The total number of bytes in the messages or less than zero for an error
+ *
+ * Each message is sent the same way as son_send_message() but several
+ * messages (with their headers) are passed to the system in a single gather
+ * write so a group of messages costs about one system call instead of two per
+ * message. Errors are reported in the handle that was first in the
+ * failed write.
+ *
+ * \code
+ * son_t messages[4];
+ * //open each message with son_open_message()
+ * son_send_messages(messages, 4, fd, 1000);
+ * \endcode
+ *
+ */
+int son_send_messages(son_t * h, int count, int fd, int timeout);
+
+/*! \details Defines the receive buffer used by son_recv_message_buffered().
+ *
+ * The memory is provided by the caller and is managed
+ * by son_init_message_buffer(). The \a read_count member can be read
+ * at any time to see how many reads were made from the descriptor.
+ *
+ */
+typedef struct {
+	u8 * buffer /*! Buffer memory */;
+	u32 size /*! Number of bytes in the buffer */;
+	u32 head /*! Offset of the first byte that hasn't been used */;
+	u32 len /*! Number of bytes that haven't been used */;
+	int fd /*! The descriptor the bytes were read from */;
+	u32 read_count /*! Number of reads from the descriptor */;
+} son_message_buffer_t;
+
+/*! \details Initializes a receive buffer for son_recv_message_buffered().
+ *
+ * @param rx A pointer to the receive buffer
+ * @param buffer The memory for the buffer
+ * @param size The number of bytes in \a buffer (at least 16, bigger buffers need fewer reads)
+ * @return Zero on success or less than zero if the buffer is too small
+ *
+ */
+int son_init_message_buffer(son_message_buffer_t * rx, void * buffer, u32 size);
+
+/*! \details Receives a message using a receive buffer.
+ *
+ * @param h A pointer to the SON handle
+ * @param fd The file descriptor to listen to
+ * @param timeout The max milliseconds to block between bytes before aborting
+ * @param rx A pointer to the receive buffer (see son_init_message_buffer())
+ * @return The number of bytes successfully received in the message or less than zero for an error
+ *
+ * This works like son_recv_message() except the descriptor is read in bulk
+ * and the start of the message is found by searching the buffer rather than
+ * reading one byte at a time. Noise on the line is skipped with a few reads
+ * instead of one read per byte. Bytes that follow the message stay in the
+ * buffer for the next call so the same buffer should be used for every message
+ * received on \a fd (the buffer is emptied if it is used with a different descriptor).
+ *
+ * \code
+ * char rx_memory[256];
+ * son_message_buffer_t rx;
+ * son_init_message_buffer(&rx, rx_memory, 256);
+ *
+ * char buffer[512];
+ * son_t handle;
+ * son_open_message(&handle, buffer, 512);
+ * son_recv_message_buffered(&handle, fd, 1000, &rx);
+ * \endcode
+ *
+ */
+int son_recv_message_buffered(son_t * h, int fd, int timeout, son_message_buffer_t * rx);
+
+/*! \details Defines the callback that receives the messages
+ * put together by son_feed_message_decoder().
+ *
+ * @param context The context passed to son_init_message_decoder()
+ * @param message A pointer to the message (can be opened with son_open_message())
+ * @param nbyte The number of bytes in the message
+ * @return Less than zero to stop decoding
+ *
+ * The memory is reused for the next message so the message must be used
+ * (or copied) before the callback returns.
+ */
+typedef int (*son_message_decoder_callback_t)(void * context, void * message, int nbyte);
+
+/*! \details Defines the state of a message decoder.
+ *
+ * The members are managed by son_init_message_decoder() and
+ * son_feed_message_decoder(). The \a message_count and \a error_count
+ * members can be read at any time.
+ *
+ */
+typedef struct {
+	u8 * message /*! Memory for the message being received */;
+	u32 size /*! Number of bytes in \a message */;
+	son_message_decoder_callback_t callback /*! Called for each complete message */;
+	void * context /*! Passed to \a callback */;
+	u32 header[3] /*! The header of the message being received (Internal use only) */;
+	u32 len /*! Number of bytes in the message being received (Internal use only) */;
+	u32 count /*! Number of bytes received in the current state (Internal use only) */;
+	u32 state /*! Decoder state (Internal use only) */;
+	u32 message_count /*! Number of messages passed to \a callback */;
+	u32 error_count /*! Number of headers that were discarded because the checksum was bad */;
+} son_message_decoder_t;
+
+/*! \details Initializes a message decoder.
+ *
+ * @param decoder A pointer to the decoder
+ * @param message Memory for the messages (messages that don't fit are truncated)
+ * @param nbyte The number of bytes in \a message
+ * @param callback Called each time a message is complete
+ * @param context Passed to \a callback
+ * @return Zero on success
+ *
+ */
+int son_init_message_decoder(son_message_decoder_t * decoder, void * message, int nbyte, son_message_decoder_callback_t callback, void * context);
+
+/*! \details Passes received bytes to a message decoder.
+ *
+ * @param decoder A pointer to the decoder
+ * @param data The bytes that were received
+ * @param nbyte The number of bytes in \a data
+ * @return The number of messages that were completed or less than zero if the callback stopped the decoder
+ *
+ * This decodes the same frames as son_recv_message() (sent by
+ * son_send_message()) but it never reads or waits. The bytes can be
+ * split up any way so one thread can read many (non-blocking) links with
+ * poll() and feed each link's decoder whatever arrives. Bytes
+ * before the start of a message are skipped.
+ *
+ * \code
+ * static int handle_message(void * context, void * message, int nbyte){
+ * 	son_t h;
+ * 	son_open_message(&h, message, nbyte);
+ * 	printf("value is %ld\n", son_read_num(&h, "value"));
+ * 	son_close(&h);
+ * 	return 0;
+ * }
+ *
+ * char message[512];
+ * son_message_decoder_t decoder;
+ * son_init_message_decoder(&decoder, message, 512, handle_message, 0);
+ *
+ * //when the link is readable
+ * char buffer[64];
+ * int bytes = read(fd, buffer, 64);
+ * if( bytes > 0 ){
+ * 	son_feed_message_decoder(&decoder, buffer, bytes);
+ * }
+ * \endcode
+ *
+ */
+int son_feed_message_decoder(son_message_decoder_t * decoder, const void * data, int nbyte);
+
 /*! \details Gets the total size of the message in bytes.
  *
  * @param h A pointer to the SON handle
@@ -305,6 +609,171 @@ int son_recv_message(son_t * h, int fd, int timeout);
  */
 int son_get_message_size(son_t * h);
 
+/*! \details Defines the header of a message ring.
+ *
+ * A ring passes messages between threads or processes without copying
+ * them. The header is followed by the slots. Each slot holds one message
+ * that is created in place by a producer (son_create_ring_message()) and read
+ * in place by the consumer (son_recv_ring_message()). Any number of
+ * producers can share the ring but there can only be one consumer.
+ *
+ * The members are managed by son_init_ring() and are not used in the API.
+ *
+ */
+typedef struct {
+	u32 magic /*! Set when the ring is ready (Internal use only) */;
+	u32 slot_size /*! Number of bytes available for each message */;
+	u32 slot_count /*! Number of slots (a power of 2) */;
+	u32 stride /*! Bytes between slots (Internal use only) */;
+	u32 resd0[12];
+	volatile u32 head /*! Next slot for producers (Internal use only) */;
+	u32 resd1[15];
+	volatile u32 tail /*! Next slot for the consumer (Internal use only) */;
+	u32 resd2[15];
+	volatile u32 signal /*! Changed each time a message is sent (Internal use only) */;
+	volatile u32 waiting /*! Non-zero while the consumer is waiting (Internal use only) */;
+	u32 resd3[14];
+} son_ring_t;
+
+/*! \details Gets the number of bytes of memory needed for a ring.
+ *
+ * @param slot_size The number of bytes available for each message
+ * @param slot_count The number of slots (must be a power of 2)
+ * @return The number of bytes that should be passed to son_init_ring()
+ *
+ */
+u32 son_get_ring_size(u32 slot_size, u32 slot_count);
+
+/*! \details Initializes a ring in memory provided by the caller.
+ *
+ * @param ring A pointer to memory (son_get_ring_size() bytes aligned to 64 bytes)
+ * @param slot_size The number of bytes available for each message
+ * @param slot_count The number of slots (must be a power of 2)
+ * @return Zero on success or less than zero if \a slot_count isn't a power of 2
+ *
+ * The memory can be shared between processes (see son_open_ring()).
+ *
+ */
+int son_init_ring(son_ring_t * ring, u32 slot_size, u32 slot_count);
+
+/*! \details Opens (or creates) a ring in POSIX shared memory.
+ *
+ * @param name The name of the shared memory object (see shm_open())
+ * @param slot_size The number of bytes available for each message
+ * @param slot_count The number of slots (must be a power of 2)
+ * @return A pointer to the ring or zero if the ring can't be opened
+ *
+ * The first process to open the ring creates and initializes it. Other
+ * processes must use the same \a slot_size and \a slot_count. The shared
+ * memory object stays until it is removed with son_unlink_ring(). A ring
+ * left behind by a process that stopped keeps its old contents, so the
+ * process that owns the ring should call son_unlink_ring() before opening it.
+ *
+ * This function is only available on POSIX hosts. For that reason it is
+ * not part of son_api_t (like son_open_mmap() and son_doc_open()).
+ *
+ */
+son_ring_t * son_open_ring(const char * name, u32 slot_size, u32 slot_count);
+
+/*! \details Unmaps a ring opened with son_open_ring().
+ *
+ * @param ring A pointer to the ring
+ * @return Zero on success
+ *
+ * The shared memory object is not removed (see son_unlink_ring()). This
+ * must not be used on memory that was set up with son_init_ring().
+ *
+ */
+int son_close_ring(son_ring_t * ring);
+
+/*! \details Removes the shared memory object of a ring.
+ *
+ * @param name The name passed to son_open_ring()
+ * @return Zero on success or less than zero if the ring doesn't exist
+ *
+ * Processes that have the ring open can keep using it. The next call to
+ * son_open_ring() creates a new ring. This function is only available
+ * on POSIX hosts.
+ *
+ */
+int son_unlink_ring(const char * name);
+
+/*! \details Creates a message in the next free slot of a ring.
+ *
+ * @param ring A pointer to the ring
+ * @param h A pointer to the handle
+ * @param stack The SON stack
+ * @param stack_size The number of entries in the SON stack
+ * @return Zero on success or less than zero with the error set to SON_ERR_RING_FULL
+ * if all the slots are in use
+ *
+ * This works like son_create_message() using the slot as the message memory.
+ * The message is written directly in the ring and given to the consumer
+ * with son_send_ring_message(). This function doesn't wait for a
+ * free slot.
+ *
+ * \code
+ * son_t h;
+ * son_stack_t stack[4];
+ * son_ring_t * ring = son_open_ring("/sensors", 256, 64);
+ *
+ * if( son_create_ring_message(ring, &h, stack, 4) == 0 ){
+ * 	son_open_object(&h, "");
+ * 	son_write_num(&h, "value", 10);
+ * 	son_send_ring_message(ring, &h);
+ * }
+ * \endcode
+ *
+ */
+int son_create_ring_message(son_ring_t * ring, son_t * h, son_stack_t * stack, son_size_t stack_size);
+
+/*! \details Closes a message created with son_create_ring_message()
+ * and passes it to the consumer.
+ *
+ * @param ring A pointer to the ring
+ * @param h A pointer to the handle
+ * @return The number of bytes in the message or less than zero for an error
+ *
+ * The handle is closed (don't call son_close()). If the consumer is
+ * waiting, it is woken up.
+ *
+ */
+int son_send_ring_message(son_ring_t * ring, son_t * h);
+
+/*! \details Opens the next message in a ring for reading.
+ *
+ * @param ring A pointer to the ring
+ * @param h A pointer to the handle
+ * @param timeout The max milliseconds to wait for a message (zero to return right away)
+ * @return The number of bytes in the message or less than zero with the error
+ * set to SON_ERR_MESSAGE_TIMEOUT
+ *
+ * The message is opened in place (like son_open_message()). The slot
+ * stays in use until the message is released with son_release_ring_message().
+ * Only one thread or process can receive from a ring.
+ *
+ * \code
+ * son_t h;
+ * son_ring_t * ring = son_open_ring("/sensors", 256, 64);
+ * if( son_recv_ring_message(ring, &h, 1000) > 0 ){
+ * 	printf("value is %ld\n", son_read_num(&h, "value"));
+ * 	son_release_ring_message(ring, &h);
+ * }
+ * \endcode
+ *
+ */
+int son_recv_ring_message(son_ring_t * ring, son_t * h, int timeout);
+
+/*! \details Closes a message opened with son_recv_ring_message()
+ * and frees the slot.
+ *
+ * @param ring A pointer to the ring
+ * @param h A pointer to the handle
+ * @return Zero on success
+ *
+ */
+int son_release_ring_message(son_ring_t * ring, son_t * h);
+
 /*! @} */
 
 /*! \addtogroup FILES File Handling (Create/Append/Open/Close)
@@ -315,6 +784,137 @@ int son_get_message_size(son_t * h);
 void son_set_driver(son_t * h, void * driver);
 #endif
 
+/*! \details Attaches a block cache to a file handle.
+ *
+ * @param h A pointer to the handle
+ * @param cache A pointer to the cache state (or null to detach the current cache)
+ * @param buffer A pointer to the page memory (must be \a page_size * \a page_count bytes)
+ * @param page_size The number of bytes in each page
+ * @param page_count The number of pages (up to SON_PHY_CACHE_PAGE_MAX)
+ * @return Less than zero for an error
+ *
+ * The cache must be attached after the file is created or opened. Once
+ * attached, reads, writes and seeks are served from memory
+ * whenever possible. Dirty pages are written back
+ * when they are evicted and when the file is closed with son_close().
+ *
+ * Message handles are already in memory so a cache can't be attached to them.
+ *
+ * \code
+ * son_t h;
+ * son_phy_cache_t cache;
+ * u8 pages[4*512];
+ * son_open(&h, "/home/data.son");
+ * son_set_cache(&h, &cache, pages, 512, 4);
+ * son_read_num(&h, "key.num");
+ * son_close(&h);
+ * //cache.hit_count and cache.miss_count show how effective the cache was
+ * \endcode
+ *
+ */
+int son_set_cache(son_t * h, son_phy_cache_t * cache, void * buffer, u32 page_size, u32 page_count);
+
+/*! \details Attaches a write buffer to a file handle.
+ *
+ * @param h A pointer to the handle
+ * @param write_buffer A pointer to the buffer state (or null to detach the current buffer)
+ * @param buffer A pointer to the buffer memory
+ * @param size The number of bytes in \a buffer
+ * @return Less than zero for an error
+ *
+ * When an object or array is closed, the size is written back to the
+ * store that opened it. Without a buffer, each close seeks back in
+ * the file and breaks up sequential writing. With a buffer, new data is
+ * held in memory and written to the file in order once the buffer is full, so objects
+ * and arrays that fit in the buffer are closed without touching the
+ * file. Larger ones are updated in the file as usual.
+ *
+ * The buffer must be attached after the file is created or appended and is
+ * written to the file by son_close(). It can't be combined with a cache
+ * (son_set_cache()) and isn't needed for messages.
+ *
+ * \code
+ * son_t h;
+ * son_stack_t stack[8];
+ * son_phy_write_buffer_t write_buffer;
+ * u8 buffer[4096];
+ * son_create(&h, "/home/log.son", stack, 8);
+ * son_set_write_buffer(&h, &write_buffer, buffer, 4096);
+ * son_open_object(&h, "");
+ * ...
+ * son_close(&h);
+ * //write_buffer.direct_count shows how many updates missed the buffer
+ * \endcode
+ *
+ */
+int son_set_write_buffer(son_t * h, son_phy_write_buffer_t * write_buffer, void * buffer, u32 size);
+
+/*! \details Sets the options used by the handle.
+ *
+ * @param h A pointer to the handle
+ * @param o_flags The options to use (bitwise OR of son_flags_t values)
+ * @return Less than zero for an error
+ *
+ * The options are cleared when the handle is created or opened so this
+ * needs to be called afterwards.
+ *
+ * With SON_FLAG_INDEX_OBJECTS, objects that have at least
+ * SON_INDEX_MIN_COUNT members get a small hash table of their keys
+ * when they are closed. Readers use the table automatically
+ * and fall back to scanning the members when it isn't present.
+ *
+ * With SON_FLAG_INDEX_ARRAYS, arrays that have at least
+ * SON_INDEX_MIN_COUNT elements get a table with the offset of every
+ * SON_INDEX_ARRAY_STRIDE-th element. Accessing "array[9999]" then takes
+ * a couple of reads instead of walking 10000 elements.
+ *
+ * SON_FLAG_LARGE selects the large document format. Each value takes 4 more
+ * bytes but the document is no longer limited to 16MB. The format is
+ * recorded in the header so it can only be selected on a new document before the
+ * root is opened. When a document is opened, the flag is set if the document
+ * uses the large format and it stays set when the options are changed.
+ *
+ * SON_FLAG_CRC is also recorded in the header and follows the same rules. A
+ * CRC32C of the document is written after the root when the handle is
+ * closed (it is updated when an existing document is appended or edited).
+ * See son_verify().
+ *
+ * \code
+ * son_t h;
+ * son_stack_t stack[4];
+ * son_create(&h, "/home/config.son", stack, 4);
+ * son_set_flags(&h, SON_FLAG_INDEX_OBJECTS | SON_FLAG_LARGE);
+ * son_open_object(&h, "");
+ * ...
+ * son_close(&h);
+ * \endcode
+ *
+ */
+int son_set_flags(son_t * h, u32 o_flags);
+
+/*! \details Checks the CRC of the whole document.
+ *
+ * @param h A pointer to the handle
+ * @return Zero if the document is intact or less than zero with the error
+ * set to SON_ERR_DOCUMENT_CRC if the CRC doesn't match or the document
+ * wasn't created with SON_FLAG_CRC
+ *
+ * Each value has its own small checksum that is normally checked every
+ * time the value is read. Once the document passes this check, the handle
+ * stops checking the values so repeated reads don't verify the same bytes
+ * over and over. The document must not be changed by anything else while the
+ * handle is open.
+ *
+ * Documents in memory are verified when they are opened (if they have
+ * a CRC) with son_open_message(), son_open_mmap(), son_doc_open() or
+ * son_doc_open_message(). If the CRC doesn't match, son_doc_open*() fails
+ * while the other functions still open the document and check each value as it
+ * is read. Documents opened with son_open() or son_open_fileno() are read
+ * from the file as needed so they are only verified by calling this function.
+ *
+ */
+int son_verify(son_t * h);
+
 /*! \details Returns the most recent error and sets the
  * current error value to SON_ERR_NONE.
  *
@@ -327,13 +927,74 @@ int son_get_error(son_t * h);
 /*! \details Exports the data in an open SON file to JSON.
  *
  * @param h A pointer to the handle
- * @param path The path to the destination JSON file
+ * @param path The path to the destination JSON file (or null to only use \a callback)
+ * @param callback Called with each chunk of output (or null)
+ * @param context Passed to \a callback
  * @return Less than zero for an error
+ *
+ * The output is collected in a buffer of SON_JSON_BUFFER_SIZE bytes and passed
+ * to the file and \a callback in zero-terminated chunks. Chunks
+ * don't line up with JSON tokens.
+ *
+ * If SON_FLAG_JSON_COMPACT is set (see son_set_flags()), the
+ * output has no indentation or line breaks.
+ *
+ * Stack usage is fixed. Strings and data are copied in chunks of
+ * SON_JSON_CHUNK_SIZE bytes, and objects and arrays can be nested
+ * up to SON_JSON_DEPTH_MAX levels.
+ *
  */
 int son_to_json(son_t * h, const char * path, int (*callback)(void * context, const char * entry), void * context);
 
 typedef int (*son_to_json_callback_t)(void*, const char*);
 
+/*! \details Imports JSON in to a SON file.
+ *
+ * @param h A pointer to the handle
+ * @param path The path to the source JSON file (or null to use \a callback)
+ * @param callback Called to read the next chunk of JSON (if \a path is null)
+ * @param context Passed to \a callback
+ * @return Less than zero for an error
+ *
+ * The handle must be created with son_create() (or son_create_message())
+ * and the root must not be open yet. The root of the JSON (an object or
+ * an array) becomes the root of the document. Call son_close() when done.
+ *
+ * The JSON is read in chunks of SON_JSON_BUFFER_SIZE bytes and
+ * strings are copied to the document as they are read, so any size
+ * of input is imported using a fixed amount of memory. The \a callback
+ * should copy up to \a nbyte bytes to \a buffer and return the number
+ * copied (zero at the end of the input).
+ *
+ * Values are saved as follows:
+ * - integers use son_write_num() if they fit in an s32, then son_write_unum(),
+ *  son_write_num64() and son_write_unum64()
+ * - other numbers use son_write_float() if they have no more than FLT_DIG significant
+ *  digits, otherwise son_write_double()
+ * - strings use son_write_str() unless SON_FLAG_JSON_DATA is set and the string
+ *  is base64 that ends with '=' padding; then the decoded bytes are saved as data.
+ *  son_to_json() only pads data whose size isn't a multiple of 3, so other data
+ *  comes back as a string (plain words like "John" or "true" are valid base64 too)
+ * - array elements are given the key "[]"
+ *
+ * Objects and arrays can be nested up to SON_JSON_DEPTH_MAX levels. The stack passed
+ * to son_create() needs one more entry than the depth of the JSON because
+ * strings are written like data objects. Invalid JSON causes
+ * SON_ERR_JSON_SYNTAX and leaves the document incomplete.
+ *
+ * \code
+ * son_t h;
+ * son_stack_t stack[16];
+ * son_create(&h, "/home/config.son", stack, 16);
+ * son_from_json(&h, "/home/config.json", 0, 0);
+ * son_close(&h);
+ * \endcode
+ *
+ */
+int son_from_json(son_t * h, const char * path, int (*callback)(void * context, char * buffer, int nbyte), void * context);
+
+typedef int (*son_from_json_callback_t)(void*, char*, int);
+
 /*! \details Creates a new SON file.
  *
  * @param h A pointer to the SON handle
@@ -378,52 +1039,191 @@ typedef int (*son_to_json_callback_t)(void*, const char*);
  * son_close(&h);
  * \endcode
  *
- * \sa WRITE
+ * \sa WRITE
+ *
+ */
+int son_create(son_t * h, const char * name, son_stack_t * stack, son_size_t stack_size);
+
+/*! \details Opens a file for appending. Items
+ * written to the file will be added to the root object or array.
+ *
+ * @param h A pointer to the handle
+ * @param name Path to the file to append
+ * @param stack A pointer to the SON stack
+ * @param stack_size The number of stack entries
+ * @return Less than zero if there was an error
+ *
+ * \code
+ * son_stack_t son_stack[10];
+ * son_t son;
+ * son_append(&son, "/home/append.son", son_stack, 10);
+ * son_write_str(&son, "str", "World"); //this will be appended to the root object or array
+ * son_close(&son); //close out all structures -- no more appending
+ * \endcode
+ *
+ * \sa  WRITE
+ */
+int son_append(son_t * h, const char * name, son_stack_t * stack, son_size_t stack_size);
+
+/*! \details Opens a file for reading.
+ *
+ * @param h A pointer to the handle
+ * @param name The path to the file to open
+ * @return Less than zero if there was an error
+ *
+ * Here is an example of how to read key data from a file.
+ *
+ * \code
+ * son_t son;
+ * u32 unum;
+ * son_open(&son, "/home/data.son");
+ * unum = son_read_unum(&son, "key.unum");
+ * son_close(&son);
+ * \endcode
+ *
+ * \sa READ
+ *
+ */
+int son_open(son_t * h, const char * name);
+
+/*! \details Opens a file for reading by mapping it into memory.
+ *
+ * @param h A pointer to the handle
+ * @param name The path to the file to open
+ * @param advice A hint describing how the file will be accessed
+ * @return Less than zero if there was an error
+ *
+ * The mapped file is accessed the same way as a message (see son_open_message())
+ * so reads and seeks don't make any system calls. The file
+ * is unmapped when the handle is closed with son_close().
+ *
+ * This function is only available on POSIX hosts (it always fails on
+ * Stratify OS and Windows).
+ *
+ * \code
+ * son_t son;
+ * son_open_mmap(&son, "/home/log.son", SON_MMAP_ADVICE_SEQUENTIAL);
+ * son_to_json(&son, "/home/log.json", 0, 0);
+ * son_close(&son);
+ * \endcode
+ *
+ * \sa READ
  *
  */
-int son_create(son_t * h, const char * name, son_stack_t * stack, son_size_t stack_size);
+int son_open_mmap(son_t * h, const char * name, son_mmap_advice_t advice);
 
-/*! \details Opens a file for appending. Items
- * written to the file will be added to the root object or array.
+/*! \details Opens a file for reading using a descriptor
+ * that is already open.
  *
  * @param h A pointer to the handle
- * @param name Path to the file to append
- * @param stack A pointer to the SON stack
- * @param stack_size The number of stack entries
+ * @param fd The file descriptor (opened for reading)
  * @return Less than zero if there was an error
  *
+ * The handle reads the file with pread() and keeps its own file
+ * position, so any number of handles can share the descriptor. Each thread
+ * can open its own handle on the same descriptor and read in parallel
+ * without any locking. son_close() doesn't close the descriptor.
+ *
+ * This function is only available on POSIX hosts (it always fails on
+ * Stratify OS and Windows).
+ *
  * \code
- * son_stack_t son_stack[10];
+ * int fd = open("/home/data.son", O_RDONLY);
+ *
+ * //in each thread
  * son_t son;
- * son_append(&son, "/home/append.son", son_stack, 10);
- * son_write_str(&son, "str", "World"); //this will be appended to the root object or array
- * son_close(&son); //close out all structures -- no more appending
+ * son_open_fileno(&son, fd);
+ * son_read_num(&son, "key.num");
+ * son_close(&son);
+ *
+ * //after all the threads are done
+ * close(fd);
  * \endcode
  *
- * \sa  WRITE
+ * \sa READ
+ *
  */
-int son_append(son_t * h, const char * name, son_stack_t * stack, son_size_t stack_size);
+int son_open_fileno(son_t * h, int fd);
 
-/*! \details Opens a file for reading.
+/*! \details Loads a document so that it can be shared by
+ * many handles (see son_open_doc()).
  *
- * @param h A pointer to the handle
- * @param name The path to the file to open
- * @return Less than zero if there was an error
+ * @param doc A pointer to the document
+ * @param name The path to the file
+ * @return Less than zero if the file can't be opened or mapped
  *
- * Here is an example of how to read key data from a file.
+ * The file is mapped in to memory once. If the document has a CRC (see
+ * SON_FLAG_CRC), it is checked (the function fails if it doesn't match)
+ * and the handles don't check the values as they are read. This function is only
+ * available on POSIX hosts (use son_doc_open_message() on Stratify OS).
+ *
+ * \sa son_doc_close()
+ *
+ */
+int son_doc_open(son_doc_t * doc, const char * name);
+
+/*! \details Shares a document that is already in memory.
+ *
+ * @param doc A pointer to the document
+ * @param message A pointer to the document data
+ * @param nbyte The number of bytes in \a message
+ * @return Less than zero if the document is not valid
+ *
+ * The memory must not be changed or freed until the document is
+ * closed and all the handles opened with son_open_doc() are closed. The CRC
+ * is checked the same way as son_doc_open().
+ *
+ */
+int son_doc_open_message(son_doc_t * doc, const void * message, int nbyte);
+
+/*! \details Releases the reference held by the opener of the document.
+ *
+ * @param doc A pointer to the document
+ * @return Zero on success
+ *
+ * The memory is released when the last handle opened with son_open_doc()
+ * is closed. son_open_doc() must not be called after this.
+ *
+ */
+int son_doc_close(son_doc_t * doc);
+
+/*! \details Opens a handle (cursor) for reading a shared document.
+ *
+ * @param h A pointer to the handle
+ * @param doc A pointer to a document opened with son_doc_open() or son_doc_open_message()
+ * @return Less than zero if there was an error (SON_ERR_DOCUMENT_CLOSED if
+ * the document has already been released)
+ *
+ * Each thread opens its own handle. The document's memory is shared: the
+ * handle gets its own copy of the phy state (a view of the shared memory
+ * with its own offset) along with its own position, error and flags, but
+ * none of the document is copied. The document is never modified so the
+ * threads can read at the same time without any locking. Opening a handle
+ * doesn't read the file (the header is checked when the document is opened)
+ * and doesn't need a stack.
+ *
+ * The handle is read only (son_edit_*() functions fail). Call son_close()
+ * when the thread is done to release the handle's reference to
+ * the document.
  *
  * \code
+ * son_doc_t doc;
+ * son_doc_open(&doc, "/home/config.son");
+ *
+ * //in each thread
  * son_t son;
- * u32 unum;
- * son_open(&son, "/home/data.son");
- * unum = son_read_unum(&son, "key.unum");
+ * son_open_doc(&son, &doc);
+ * son_read_num(&son, "key.num");
  * son_close(&son);
+ *
+ * //the memory is unmapped after the last handle is closed
+ * son_doc_close(&doc);
  * \endcode
  *
  * \sa READ
  *
  */
-int son_open(son_t * h, const char * name);
+int son_open_doc(son_t * h, son_doc_t * doc);
 
 /*! \details Closes a file that was opened or created with
  * son_create(), son_append(), or son_open().
@@ -565,6 +1365,36 @@ int son_write_unum(son_t * h, const char * key, u32 unum);
  */
 int son_write_float(son_t * h, const char * key, float fnum);
 
+/*! \details Writes a signed 64-bit number to the file.
+ *
+ * @param h A pointer to the handler
+ * @param key The key to associate with the value
+ * @param num The value to save
+ * @return Less than zero on an error
+ *
+ */
+int son_write_num64(son_t * h, const char * key, s64 num);
+
+/*! \details Writes an unsigned 64-bit number to the file.
+ *
+ * @param h A pointer to the handler
+ * @param key The key to associate with the value
+ * @param unum The value to save
+ * @return Less than zero on an error
+ *
+ */
+int son_write_unum64(son_t * h, const char * key, u64 unum);
+
+/*! \details Writes a double precision floating point value to the file.
+ *
+ * @param h A pointer to the handler
+ * @param key The key to associate with the value
+ * @param dnum The value to save
+ * @return Less than zero on an error
+ *
+ */
+int son_write_double(son_t * h, const char * key, double dnum);
+
 /*! \details Writes a true value to the file.
  *
  * @param h A pointer to the handler
@@ -614,6 +1444,43 @@ int son_write_data(son_t * h, const char * key, const void * data, son_size_t si
  */
 int son_write_open_data(son_t * h, const void * data, son_size_t size);
 
+/*! \details Writes a packed array of unsigned 32-bit values to the file.
+ *
+ * @param h A pointer to the handler
+ * @param key The key to associate with the array
+ * @param values A pointer to the values to save
+ * @param count The number of values to save
+ * @return Less than zero on an error
+ *
+ * A packed array uses a single store for all the values
+ * rather than one store (24 bytes) per element like son_open_array() does. The
+ * elements are written with one call to the file. They can be read back
+ * in ranges using son_read_array_u32(). son_to_json() prints them as
+ * regular JSON arrays.
+ *
+ * \code
+ * u32 samples[256];
+ * son_write_array_u32(&h, "samples", samples, 256);
+ * \endcode
+ *
+ */
+int son_write_array_u32(son_t * h, const char * key, const u32 * values, u32 count);
+
+/*! \details Writes a packed array of unsigned 8-bit values (see son_write_array_u32()). */
+int son_write_array_u8(son_t * h, const char * key, const u8 * values, u32 count);
+
+/*! \details Writes a packed array of signed 16-bit values (see son_write_array_u32()). */
+int son_write_array_s16(son_t * h, const char * key, const s16 * values, u32 count);
+
+/*! \details Writes a packed array of signed 32-bit values (see son_write_array_u32()). */
+int son_write_array_s32(son_t * h, const char * key, const s32 * values, u32 count);
+
+/*! \details Writes a packed array of float values (see son_write_array_u32()). */
+int son_write_array_float(son_t * h, const char * key, const float * values, u32 count);
+
+/*! \details Writes a packed array of double values (see son_write_array_u32()). */
+int son_write_array_double(son_t * h, const char * key, const double * values, u32 count);
+
 /*! @} */
 
 /*! \addtogroup READ Reading Values
@@ -630,6 +1497,56 @@ int son_write_open_data(son_t * h, const void * data, son_size_t size);
 #define SON_ACCESS_NAME_SIZE (SON_ACCESS_MAX_USER_SIZE+2)
 #define SON_ACCESS_NAME_CAPACITY (SON_ACCESS_NAME_SIZE+1)
 
+/*! \details Defines the maximum number of steps (keys
+ * and array indices) in a compiled access path. For
+ * example, "a.b[3].c" has four steps.
+ *
+ * \showinitializer
+ */
+#if !defined SON_PATH_STEP_COUNT
+#define SON_PATH_STEP_COUNT 12
+#endif
+
+/*! \details Marks a compiled path step as a key rather than an array index. */
+#define SON_PATH_KEY ((u32)-1)
+
+/*! \details Defines a single step in a compiled access path (Internal use only). */
+typedef struct {
+	u32 index /*! The array index or SON_PATH_KEY */;
+	char key[SON_KEY_NAME_CAPACITY] /*! The zero padded key */;
+} son_path_step_t;
+
+/*! \details Defines a compiled access path.
+ *
+ * The members are managed by son_path_compile() and are not used in the API.
+ *
+ * \sa son_path_compile()
+ */
+typedef struct {
+	u32 count /*! The number of steps in the path */;
+	son_path_step_t step[SON_PATH_STEP_COUNT];
+} son_path_t;
+
+/*! \details Compiles an access string so that it can be used
+ * over and over without being parsed each time.
+ *
+ * @param path A pointer to the destination path
+ * @param access The access string (same format as the other read functions)
+ * @return Zero on success or less than zero if \a access is too long, has too
+ * many steps, or is not formatted correctly
+ *
+ * \code
+ * son_path_t path;
+ * son_path_compile(&path, "a.b[3].c");
+ * while(1){
+ *   s32 value = son_read_num_path(&h, &path);
+ *   ...
+ * }
+ * \endcode
+ *
+ */
+int son_path_compile(son_path_t * path, const char * access);
+
 /*! \details Seeks to the value specified by \a access and
  * copies the size of the data.
  *
@@ -728,6 +1645,48 @@ u32 son_read_unum(son_t * h, const char * access);
  */
 float son_read_float(son_t * h, const char * access);
 
+/*! \details Reads the value specified by \a access as a signed 64-bit integer.
+ *
+ * @param h A pointer to the handler
+ * @param access The access string
+ * @return The value
+ *
+ * If the base value is not a signed 64-bit integer, it will be converted to
+ * one if possible. SON_STRING is converted using strtoll() and
+ * SON_DATA cannot be converted (error will be set to
+ * SON_ERR_CANNOT_CONVERT and 0 will be returned).
+ *
+ */
+s64 son_read_num64(son_t * h, const char * access);
+
+/*! \details Reads the value specified by \a access as an unsigned 64-bit integer.
+ *
+ * @param h A pointer to the handler
+ * @param access The access string
+ * @return The value
+ *
+ * If the base value is not an unsigned 64-bit integer, it will be converted to
+ * one if possible. SON_STRING is converted using strtoull() and
+ * SON_DATA cannot be converted (error will be set to
+ * SON_ERR_CANNOT_CONVERT and 0 will be returned).
+ *
+ */
+u64 son_read_unum64(son_t * h, const char * access);
+
+/*! \details Reads the value specified by \a access as a double precision floating point value.
+ *
+ * @param h A pointer to the handler
+ * @param access The access string
+ * @return The value
+ *
+ * If the base value is not a double, it will be converted to
+ * one if possible. SON_STRING is converted using strtod() and
+ * SON_DATA cannot be converted (error will be set to
+ * SON_ERR_CANNOT_CONVERT and 0.0 will be returned).
+ *
+ */
+double son_read_double(son_t * h, const char * access);
+
 
 /*! \details Reads the value specified by \a access as raw data (no type).
  *
@@ -743,6 +1702,173 @@ float son_read_float(son_t * h, const char * access);
  */
 int son_read_data(son_t * h, const char * access, void * data, son_size_t size);
 
+/*! \details Reads a range of values from a packed array of unsigned 32-bit values.
+ *
+ * @param h A pointer to the handler
+ * @param access The access string
+ * @param values A pointer to the destination (or null to get the number of elements)
+ * @param offset The index of the first element to read
+ * @param count The maximum number of elements to read
+ * @return The number of elements read or less than zero on an error
+ *
+ * The whole range is copied with a single read. The array must
+ * have been written using son_write_array_u32(). Otherwise, the error is set to
+ * SON_ERR_CANNOT_CONVERT (no conversion between element types is done).
+ * If \a offset is past the end of the array, zero is returned.
+ *
+ * \code
+ * u32 samples[64];
+ * int total = son_read_array_u32(&h, "samples", 0, 0, 0);
+ * int count = son_read_array_u32(&h, "samples", samples, 128, 64); //elements 128 to 191
+ * \endcode
+ *
+ */
+int son_read_array_u32(son_t * h, const char * access, u32 * values, u32 offset, u32 count);
+
+/*! \details Reads a range of unsigned 8-bit values (see son_read_array_u32()). */
+int son_read_array_u8(son_t * h, const char * access, u8 * values, u32 offset, u32 count);
+
+/*! \details Reads a range of signed 16-bit values (see son_read_array_u32()). */
+int son_read_array_s16(son_t * h, const char * access, s16 * values, u32 offset, u32 count);
+
+/*! \details Reads a range of signed 32-bit values (see son_read_array_u32()). */
+int son_read_array_s32(son_t * h, const char * access, s32 * values, u32 offset, u32 count);
+
+/*! \details Reads a range of float values (see son_read_array_u32()). */
+int son_read_array_float(son_t * h, const char * access, float * values, u32 offset, u32 count);
+
+/*! \details Reads a range of double values (see son_read_array_u32()). */
+int son_read_array_double(son_t * h, const char * access, double * values, u32 offset, u32 count);
+
+/*! \details Reads the value specified by a compiled \a path as a string value.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @param str A pointer to the destination string
+ * @param capacity The max capacity of the destination string
+ * @return Less than zero on an error
+ *
+ * \sa son_read_str()
+ */
+int son_read_str_path(son_t * h, const son_path_t * path, char * str, son_size_t capacity);
+
+/*! \details Reads the value specified by a compiled \a path as a signed integer.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_num() for conversion details)
+ *
+ */
+s32 son_read_num_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as an unsigned integer.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_unum() for conversion details)
+ *
+ */
+u32 son_read_unum_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as a floating point value.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_float() for conversion details)
+ *
+ */
+float son_read_float_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as a signed 64-bit integer.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_num64() for conversion details)
+ *
+ */
+s64 son_read_num64_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as an unsigned 64-bit integer.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_unum64() for conversion details)
+ *
+ */
+u64 son_read_unum64_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as a double.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return The value (see son_read_double() for conversion details)
+ *
+ */
+double son_read_double_path(son_t * h, const son_path_t * path);
+
+/*! \details Reads the value specified by a compiled \a path as raw data (no type).
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @param data A pointer to the destination data
+ * @param size The number of bytes available at the destination
+ * @return Less than zero on an error
+ *
+ */
+int son_read_data_path(son_t * h, const son_path_t * path, void * data, son_size_t size);
+
+/*! \details Reads the value specified by a compiled \a path as a boolean.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @return Less than zero on an error
+ *
+ */
+int son_read_bool_path(son_t * h, const son_path_t * path);
+
+/*! \details Gets a pointer to the value specified by a compiled \a path without copying it.
+ *
+ * @param h A pointer to the handler
+ * @param path The compiled access path (see son_path_compile())
+ * @param ptr A pointer that is assigned the location of the value
+ * @param size A pointer to the destination size (can be null)
+ * @param type A pointer to the destination value type (can be null)
+ * @return The number of bytes in the value or less than zero on an error
+ *
+ * \sa son_read_view()
+ */
+int son_read_view_path(son_t * h, const son_path_t * path, const void ** ptr, son_size_t * size, son_value_t * type);
+
+/*! \details Gets a pointer to the value specified by \a access without copying it.
+ *
+ * @param h A pointer to the handler
+ * @param access The access string
+ * @param ptr A pointer that is assigned the location of the value
+ * @param size A pointer to the destination size (can be null)
+ * @param type A pointer to the destination value type (can be null)
+ * @return The number of bytes in the value or less than zero on an error
+ *
+ * This only works for handles whose data is already in memory (son_open_message(),
+ * son_open_mmap() and son_open_doc()). Other handles set the error to SON_ERR_NO_MESSAGE.
+ *
+ * The pointer refers directly to the memory of the message and is valid
+ * until the message is modified or the handle is closed. It is
+ * not necessarily aligned. For SON_STRING values the size includes
+ * the zero terminator.
+ *
+ * \code
+ * const void * blob;
+ * son_size_t size;
+ * son_value_t type;
+ * son_open_message(&h, buffer, buffer_size);
+ * if( son_read_view(&h, "telemetry.blob", &blob, &size, &type) >= 0 ){
+ *   process(blob, size);
+ * }
+ * \endcode
+ *
+ */
+int son_read_view(son_t * h, const char * access, const void ** ptr, son_size_t * size, son_value_t * type);
+
 /*! \details Reads the value specified by \a access as a boolean.
  *
  * @param h A pointer to the handler
@@ -841,6 +1967,42 @@ int son_edit_num(son_t *h, const char * access, s32 value);
  */
 int son_edit_unum(son_t * h, const char * access, u32 value);
 
+/*! \details Edits a signed 64-bit integer value.
+ *
+ * @param h A pointer to the handle
+ * @param access The access string
+ * @param value The new value
+ * @return Less than zero for an error
+ *
+ * \sa son_edit()
+ *
+ */
+int son_edit_num64(son_t * h, const char * access, s64 value);
+
+/*! \details Edits an unsigned 64-bit integer value.
+ *
+ * @param h A pointer to the handle
+ * @param access The access string
+ * @param value The new value
+ * @return Less than zero for an error
+ *
+ * \sa son_edit()
+ *
+ */
+int son_edit_unum64(son_t * h, const char * access, u64 value);
+
+/*! \details Edits a double value.
+ *
+ * @param h A pointer to the handle
+ * @param access The access string
+ * @param value The new value
+ * @return Less than zero for an error
+ *
+ * \sa son_edit()
+ *
+ */
+int son_edit_double(son_t * h, const char * access, double value);
+
 /*! \details Edits a true or false value.
  *
  * @param h A pointer to the handle
@@ -904,6 +2066,58 @@ typedef struct MCU_PACK {
 	int (*recv_message)(son_t * h, int fd, int timeout);
 	int (*get_message_size)(son_t * h);
 	int (*seek_next)(son_t * h, char * name, son_value_t * type);
+	int (*set_cache)(son_t * h, son_phy_cache_t * cache, void * buffer, u32 page_size, u32 page_count);
+	int (*read_view)(son_t * h, const char * access, const void ** ptr, son_size_t * size, son_value_t * type);
+	int (*path_compile)(son_path_t * path, const char * access);
+	int (*read_str_path)(son_t * h, const son_path_t * path, char * str, son_size_t capacity);
+	s32 (*read_num_path)(son_t * h, const son_path_t * path);
+	u32 (*read_unum_path)(son_t * h, const son_path_t * path);
+	float (*read_float_path)(son_t * h, const son_path_t * path);
+	int (*read_data_path)(son_t * h, const son_path_t * path, void * data, son_size_t size);
+	int (*read_bool_path)(son_t * h, const son_path_t * path);
+	int (*read_view_path)(son_t * h, const son_path_t * path, const void ** ptr, son_size_t * size, son_value_t * type);
+	int (*set_flags)(son_t * h, u32 o_flags);
+	int (*write_array_u8)(son_t * h, const char * key, const u8 * values, u32 count);
+	int (*write_array_s16)(son_t * h, const char * key, const s16 * values, u32 count);
+	int (*write_array_u32)(son_t * h, const char * key, const u32 * values, u32 count);
+	int (*write_array_s32)(son_t * h, const char * key, const s32 * values, u32 count);
+	int (*write_array_float)(son_t * h, const char * key, const float * values, u32 count);
+	int (*write_array_double)(son_t * h, const char * key, const double * values, u32 count);
+	int (*read_array_u8)(son_t * h, const char * access, u8 * values, u32 offset, u32 count);
+	int (*read_array_s16)(son_t * h, const char * access, s16 * values, u32 offset, u32 count);
+	int (*read_array_u32)(son_t * h, const char * access, u32 * values, u32 offset, u32 count);
+	int (*read_array_s32)(son_t * h, const char * access, s32 * values, u32 offset, u32 count);
+	int (*read_array_float)(son_t * h, const char * access, float * values, u32 offset, u32 count);
+	int (*read_array_double)(son_t * h, const char * access, double * values, u32 offset, u32 count);
+	int (*write_num64)(son_t * h, const char * key, s64 num);
+	int (*write_unum64)(son_t * h, const char * key, u64 unum);
+	int (*write_double)(son_t * h, const char * key, double dnum);
+	s64 (*read_num64)(son_t * h, const char * access);
+	u64 (*read_unum64)(son_t * h, const char * access);
+	double (*read_double)(son_t * h, const char * access);
+	s64 (*read_num64_path)(son_t * h, const son_path_t * path);
+	u64 (*read_unum64_path)(son_t * h, const son_path_t * path);
+	double (*read_double_path)(son_t * h, const son_path_t * path);
+	int (*edit_num64)(son_t * h, const char * access, s64 value);
+	int (*edit_unum64)(son_t * h, const char * access, u64 value);
+	int (*edit_double)(son_t * h, const char * access, double value);
+	int (*from_json)(son_t * h, const char * path, int (*callback)(void * context, char * buffer, int nbyte), void * context);
+	int (*set_write_buffer)(son_t * h, son_phy_write_buffer_t * write_buffer, void * buffer, u32 size);
+	int (*doc_open_message)(son_doc_t * doc, const void * message, int nbyte);
+	int (*doc_close)(son_doc_t * doc);
+	int (*open_doc)(son_t * h, son_doc_t * doc);
+	int (*verify)(son_t * h);
+	int (*init_message_buffer)(son_message_buffer_t * rx, void * buffer, u32 size);
+	int (*recv_message_buffered)(son_t * h, int fd, int timeout, son_message_buffer_t * rx);
+	int (*init_message_decoder)(son_message_decoder_t * decoder, void * message, int nbyte, son_message_decoder_callback_t callback, void * context);
+	int (*feed_message_decoder)(son_message_decoder_t * decoder, const void * data, int nbyte);
+	int (*send_messages)(son_t * h, int count, int fd, int timeout);
+	u32 (*get_ring_size)(u32 slot_size, u32 slot_count);
+	int (*init_ring)(son_ring_t * ring, u32 slot_size, u32 slot_count);
+	int (*create_ring_message)(son_ring_t * ring, son_t * h, son_stack_t * stack, son_size_t stack_size);
+	int (*send_ring_message)(son_ring_t * ring, son_t * h);
+	int (*recv_ring_message)(son_ring_t * ring, son_t * h, int timeout);
+	int (*release_ring_message)(son_ring_t * ring, son_t * h);
 } son_api_t;
 
 extern const son_api_t son_api;
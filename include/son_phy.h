@@ -27,6 +27,108 @@ typedef int64_t s64;
 #include <sys/types.h>
 #include <stdio.h>
 
+/*! \brief SON File Offset Type
+ * \details Offsets are 64-bit on hosts so that large
+ * documents (see SON_FLAG_LARGE) can be accessed.
+ */
+#if defined __StratifyOS__
+typedef s32 son_phy_off_t;
+#else
+typedef s64 son_phy_off_t;
+#endif
+
+/*! \details Defines the maximum number of pages that
+ * can be managed by a single block cache.
+ *
+ * \showinitializer
+ */
+#if !defined SON_PHY_CACHE_PAGE_MAX
+#define SON_PHY_CACHE_PAGE_MAX 16
+#endif
+
+/*! \details Lists the access pattern hints that can
+ * be passed to son_open_mmap().
+ */
+typedef enum {
+	SON_MMAP_ADVICE_NORMAL /*! No special treatment */,
+	SON_MMAP_ADVICE_SEQUENTIAL /*! The document will be scanned from start to end (e.g. son_to_json()) */,
+	SON_MMAP_ADVICE_RANDOM /*! Values will be accessed in random order */
+} son_mmap_advice_t;
+
+enum {
+	SON_PHY_FLAG_FILENO = (1<<0) /*! The file is accessed with pread()/pwrite() on a descriptor owned by the caller */,
+	SON_PHY_FLAG_READ_ONLY = (1<<1) /*! Writes are rejected (the memory is shared with other handles) */
+};
+
+enum {
+	SON_PHY_PAGE_FLAG_VALID = (1<<0),
+	SON_PHY_PAGE_FLAG_DIRTY = (1<<1)
+};
+
+/*! \details Defines the maximum number of buffers that
+ * son_phy_writev_fileno() passes to the system in one call.
+ *
+ * \showinitializer
+ */
+#if !defined SON_PHY_IOV_MAX
+#define SON_PHY_IOV_MAX 16
+#endif
+
+/*! \details Defines one buffer of a gather write (see son_phy_writev_fileno()). */
+typedef struct {
+	const void * buffer /*! Pointer to the bytes */;
+	u32 nbyte /*! Number of bytes */;
+} son_phy_iovec_t;
+
+/*! \details Defines a page of the block cache (Internal use only). */
+typedef struct {
+	son_phy_off_t offset /*! File offset of the first byte in the page */;
+	u32 tick /*! Last access time (used for LRU replacement) */;
+	u16 size /*! Number of valid bytes in the page */;
+	u16 o_flags /*! Page state flags */;
+} son_phy_page_t;
+
+/*! \details Defines the state of the block cache that
+ * can be attached to a file using son_set_cache().
+ *
+ * The memory is provided by the caller. The \a hit_count,
+ * \a miss_count and \a writeback_count members can be read
+ * at any time to see how well the cache is performing.
+ *
+ */
+typedef struct {
+	u8 * buffer /*! Page memory (page_size * page_count bytes) */;
+	u32 page_size /*! Number of bytes in each page */;
+	u32 page_count /*! Number of pages in use */;
+	son_phy_off_t offset /*! Logical file position */;
+	son_phy_off_t phy_offset /*! Position of the underlying file (-1 if unknown) */;
+	u32 tick /*! Access counter */;
+	u32 hit_count /*! Number of page lookups served from memory */;
+	u32 miss_count /*! Number of page lookups that required a read from the file */;
+	u32 writeback_count /*! Number of dirty pages written back to the file */;
+	son_phy_page_t page[SON_PHY_CACHE_PAGE_MAX];
+} son_phy_cache_t;
+
+/*! \details Defines the state of the write buffer that
+ * can be attached to a file using son_set_write_buffer().
+ *
+ * The buffer holds the end of the file. Bytes before \a start
+ * have been written to the file. The memory is provided by the caller. The
+ * \a flush_count and \a direct_count members can be read at any time to see
+ * how often the file was accessed.
+ *
+ */
+typedef struct {
+	u8 * buffer /*! Buffer memory */;
+	u32 size /*! Number of bytes in the buffer */;
+	u32 len /*! Number of bytes held in the buffer */;
+	son_phy_off_t start /*! File offset of the first byte in the buffer */;
+	son_phy_off_t offset /*! Logical file position */;
+	son_phy_off_t phy_offset /*! Position of the underlying file (-1 if unknown) */;
+	u32 flush_count /*! Number of times the buffer was written to the file */;
+	u32 direct_count /*! Number of writes that went straight to the file (backpatches of flushed data or writes larger than the buffer) */;
+} son_phy_write_buffer_t;
+
 #if !defined __StratifyOS__
 
 typedef struct MCU_PACK {
@@ -38,8 +140,13 @@ typedef struct MCU_PACK {
 	void * driver;
 #endif
 	void * message;
-	u16 message_size;
-	u16 message_offset;
+	son_phy_off_t message_size;
+	son_phy_off_t message_offset;
+	son_phy_cache_t * cache;
+	son_phy_write_buffer_t * write_buffer;
+	son_phy_off_t file_offset /* Position of the file (-1 if unknown) */;
+	u8 file_op /* The last file operation (stdio needs a seek between reading and writing) */;
+	u8 o_flags /* Backend flags */;
 } son_phy_t;
 
 #if defined __link
@@ -83,8 +190,12 @@ typedef struct MCU_PACK {
 typedef struct MCU_PACK {
 	int fd;
 	void * message;
-	u16 message_size;
-	u16 message_offset;
+	son_phy_off_t message_size;
+	son_phy_off_t message_offset;
+	son_phy_cache_t * cache;
+	son_phy_write_buffer_t * write_buffer;
+	son_phy_off_t file_offset /* Position of the file (-1 if unknown) */;
+	u8 o_flags /* Backend flags */;
 } son_phy_t;
 
 #endif
@@ -97,13 +208,20 @@ extern "C" {
 void son_phy_set_driver(son_phy_t * phy, void * driver);
 void son_phy_msleep(int ms);
 int son_phy_open_message(son_phy_t * phy, void * message, u32 size);
+int son_phy_open_mmap(son_phy_t * phy, const char * name, int advice);
 int son_phy_open(son_phy_t * phy, const char * name, int32_t flags, int32_t mode);
+int son_phy_open_fileno(son_phy_t * phy, int fd);
 int son_phy_read(son_phy_t * phy, void * buffer, u32 nbyte);
 int son_phy_write(son_phy_t * phy, const void * buffer, u32 nbyte);
 int son_phy_read_fileno(son_phy_t * phy, int fd, void * buffer, u32 nbyte);
 int son_phy_write_fileno(son_phy_t * phy, int fd, const void * buffer, u32 nbyte);
-int son_phy_lseek(son_phy_t * phy, int32_t offset, int whence);
+int son_phy_wait_fileno(son_phy_t * phy, int fd, int is_write, int ms);
+int son_phy_writev_fileno(son_phy_t * phy, int fd, const son_phy_iovec_t * iov, int count);
+son_phy_off_t son_phy_lseek(son_phy_t * phy, son_phy_off_t offset, int whence);
 int son_phy_close(son_phy_t * phy);
+int son_phy_set_cache(son_phy_t * phy, son_phy_cache_t * cache, void * buffer, u32 page_size, u32 page_count);
+int son_phy_set_write_buffer(son_phy_t * phy, son_phy_write_buffer_t * write_buffer, void * buffer, u32 size);
+int son_phy_flush(son_phy_t * phy);
 
 #if defined __cplusplus
 }
@@ -3,38 +3,71 @@
 
 #include "son_local.h"
 
-#if defined __StratifyOS__
+#if SON_HANDLE_CHECKSUM
 #include <cortexm/cortexm.h>
-#else
-#define cortexm_assign_zero_sum32(x,y)
-#define cortexm_verify_zero_sum32(x,y) 1
 #endif
 
-static void phy_fputs(son_phy_t * phy, son_to_json_callback_t callback, void * context, const char * str);
-
-static void phy_fprintf(son_phy_t * phy, son_to_json_callback_t callback, void * context, const char * format, ...);
-static void print_indent(int indent, son_phy_t * phy, son_to_json_callback_t callback, void * context);
-static void to_json_recursive(son_t * h,
+//JSON output is collected here and passed on in chunks
+typedef struct {
+	son_phy_t * phy;
+	son_to_json_callback_t callback;
+	void * context;
+	int is_compact;
+	u32 len;
+	char buffer[SON_JSON_BUFFER_SIZE+1]; //one extra byte for the zero terminator
+} json_writer_t;
+
+static void json_flush(json_writer_t * w);
+static void json_write(json_writer_t * w, const char * str, u32 nbyte);
+static void json_puts(json_writer_t * w, const char * str);
+static void json_printf(json_writer_t * w, const char * format, ...);
+static void json_indent(json_writer_t * w, int indent);
+static void json_newline(json_writer_t * w);
+static void json_key(json_writer_t * w, const u8 * key);
+//one frame for each object or array that is open while converting to JSON
+typedef struct {
+	son_size_t last_pos;
+	u8 is_array;
+	u8 is_first;
+	u8 is_done;
+	u8 resd;
+} json_frame_t;
+
+static int to_json_traverse(son_t * h,
 		son_size_t last_pos,
-		int indent,
 		int is_array,
-		son_phy_t * phy,
-		son_to_json_callback_t callback,
-		void * context);
-
+		json_writer_t * w);
+static void to_json_value(son_t * h,
+		u8 type,
+		son_size_t data_size,
+		json_writer_t * w);
+
+static void to_json_typed_array(son_t * h,
+		son_size_t data_size,
+		int indent,
+		json_writer_t * w);
 static int open_from_phy(son_t * h);
 static int create_from_phy(son_t * h, son_stack_t * stack, size_t stack_size);
 static int edit_from_phy(son_t * h);
+static int read_header(son_t * h);
+static int write_header(son_t * h);
+static int doc_from_phy(son_doc_t * doc);
+static int crc_calc(son_t * h, son_size_t * end, u32 * crc);
+static int root_end(son_t * h, son_size_t * end);
 
 static void store_set_checksum(son_store_t * store);
 
-static char * is_token_array(char * tok, son_size_t * index);
-static int seek_array_key(son_t * h, son_size_t ind, son_store_t * store, son_size_t * size);
-static int seek_key(son_t * h, const char * name, son_store_t * ob, son_size_t * size);
+//the reference count is updated with atomic operations
+_Static_assert((offsetof(son_doc_t, ref_count) % sizeof(u32)) == 0, "son_doc_t ref_count must be aligned");
+_Static_assert(_Alignof(son_doc_t) >= sizeof(u32), "son_doc_t must be aligned");
+
+static int path_compile(son_path_t * path, const char * access);
+static int path_add_step(son_path_t * path, const char * key, int len, u32 index);
+static int seek_array_key(son_t * h, const son_store_t * parent, son_size_t ind, son_store_t * store, son_size_t * size);
+static int seek_array_table(son_t * h, const son_store_t * parent, son_size_t * ind);
+static int seek_key(son_t * h, const son_store_t * parent, const char * name, son_store_t * ob, son_size_t * size);
+static int seek_key_index(son_t * h, const son_store_t * parent, const char * name, son_store_t * ob, son_size_t * size);
 
-static int base64_encode(char * dest, const void * src, int nbyte);
-static int base64_calc_encoded_size(int nbyte);
-static char base64_encode_six(uint8_t six_bit_value);
 
 #if !defined __StratifyOS__
 void son_set_driver(son_t * h, void * handle){
@@ -42,6 +75,170 @@ void son_set_driver(son_t * h, void * handle){
 }
 #endif
 
+int son_set_cache(son_t * h, son_phy_cache_t * cache, void * buffer, u32 page_size, u32 page_count){
+	int ret = 0;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	if( son_phy_set_cache(&(h->phy), cache, buffer, page_size, page_count) < 0 ){
+		h->err = SON_ERR_INVALID_CACHE;
+		ret = -1;
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+int son_set_write_buffer(son_t * h, son_phy_write_buffer_t * write_buffer, void * buffer, u32 size){
+	int ret = 0;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	if( son_phy_set_write_buffer(&(h->phy), write_buffer, buffer, size) < 0 ){
+		h->err = SON_ERR_INVALID_CACHE;
+		ret = -1;
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+int son_set_flags(son_t * h, u32 o_flags){
+	u32 header;
+	u32 add;
+	int ret = 0;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	//the format is set by the document header
+	header = h->o_flags & SON_LOCAL_FLAG_HEADER;
+	add = o_flags & SON_LOCAL_FLAG_HEADER & ~header;
+	if( add ){
+		//the header can only be changed before anything else is written
+		if( (h->stack_size == 0) ||
+				(h->stack_loc != 0) ||
+				(son_local_phy_lseek_current(h, 0) != sizeof(son_hdr_t)) ){
+			h->err = SON_ERR_CANNOT_WRITE;
+			ret = -1;
+		} else {
+			h->o_flags |= add;
+			if( (son_local_phy_lseek_set(h, 0) < 0) || (write_header(h) < 0) ){
+				h->o_flags &= ~add;
+				ret = -1;
+			} else {
+				header |= add;
+			}
+		}
+	}
+
+	h->o_flags = (o_flags & ~(SON_LOCAL_FLAG_HEADER | SON_LOCAL_FLAG_VERIFIED | SON_LOCAL_FLAG_MODIFIED)) |
+			header |
+			(h->o_flags & (SON_LOCAL_FLAG_VERIFIED | SON_LOCAL_FLAG_MODIFIED));
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+int son_verify(son_t * h){
+	son_phy_off_t pos;
+	son_size_t end;
+	u32 crc;
+	u32 doc_crc;
+	int ret = 0;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	if( (h->o_flags & SON_FLAG_CRC) == 0 ){
+		h->err = SON_ERR_DOCUMENT_CRC;
+		ret = -1;
+	} else {
+		pos = son_local_phy_lseek_current(h, 0);
+		if( crc_calc(h, &end, &crc) < 0 ){
+			ret = -1;
+		} else if( (son_local_phy_lseek_set(h, end) < 0) ||
+				(son_phy_read(&(h->phy), &doc_crc, sizeof(doc_crc)) != sizeof(doc_crc)) ||
+				(doc_crc != crc) ){
+			h->err = SON_ERR_DOCUMENT_CRC;
+			ret = -1;
+		} else {
+			h->o_flags |= SON_LOCAL_FLAG_VERIFIED;
+		}
+		son_local_phy_lseek_set(h, pos);
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+int son_local_crc_write(son_t * h){
+	son_size_t end;
+	u32 crc;
+
+	if( crc_calc(h, &end, &crc) < 0 ){
+		return -1;
+	}
+
+	//the CRC follows the root (anything after it was left by an earlier CRC)
+	if( (son_local_phy_lseek_set(h, end) < 0) ||
+			(son_phy_write(&(h->phy), &crc, sizeof(crc)) != sizeof(crc)) ){
+		h->err = SON_ERR_WRITE_IO;
+		return -1;
+	}
+	h->o_flags &= ~SON_LOCAL_FLAG_MODIFIED;
+	return 0;
+}
+
+int root_end(son_t * h, son_size_t * end){
+	son_store_t store;
+
+	//the root store gives the end of the document
+	if( (son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0) ||
+			(son_local_store_read(h, &store) != 1) ){
+		return -1;
+	}
+	*end = son_local_store_next(&store);
+	return 0;
+}
+
+int crc_calc(son_t * h, son_size_t * end, u32 * crc){
+	u8 buffer[SON_CRC_BUFFER_SIZE];
+	son_size_t pos;
+	u32 nbyte;
+	int ret;
+
+	if( root_end(h, end) < 0 ){
+		return -1;
+	}
+
+	if( h->phy.message ){
+		if( (son_phy_off_t)*end > h->phy.message_size ){
+			h->err = SON_ERR_DOCUMENT_CRC;
+			return -1;
+		}
+		*crc = son_local_crc32c(0, h->phy.message, *end);
+		return 0;
+	}
+
+	if( son_local_phy_lseek_set(h, 0) < 0 ){
+		return -1;
+	}
+
+	*crc = 0;
+	for(pos = 0; pos < *end; pos += nbyte){
+		nbyte = *end - pos;
+		if( nbyte > SON_CRC_BUFFER_SIZE ){
+			nbyte = SON_CRC_BUFFER_SIZE;
+		}
+		ret = son_phy_read(&(h->phy), buffer, nbyte);
+		if( ret != (int)nbyte ){
+			h->err = (ret < 0) ? SON_ERR_READ_IO : SON_ERR_DOCUMENT_CRC;
+			return -1;
+		}
+		*crc = son_local_crc32c(*crc, buffer, nbyte);
+	}
+
+	return 0;
+}
+
 int son_get_error(son_t * h){
 	int err = h->err;
 	if( err != SON_ERR_HANDLE_CHECKSUM ){
@@ -55,12 +252,13 @@ int son_append(son_t * h, const char * name, son_stack_t * stack, son_size_t sta
 	son_store_t store;
 	int ret = 0;
 
+	h->doc = 0;
 	if( son_phy_open(&(h->phy), name, SON_O_RDWR, 0666) < 0 ){
 		h->err = SON_ERR_OPEN_IO;
 		ret = -1;
 	} else {
 
-		if( son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0 ){
+		if( read_header(h) < 0 ){
 			ret = -1;
 		} else {
 
@@ -118,6 +316,77 @@ int son_open(son_t * h, const char * name){
 	return open_from_phy(h);
 }
 
+int son_open_mmap(son_t * h, const char * name, son_mmap_advice_t advice){
+	//open for read only -- stack is not used
+	if( son_phy_open_mmap(&(h->phy), name, advice) < 0 ){
+		h->err = SON_ERR_OPEN_IO;
+		return -1;
+	}
+	return open_from_phy(h);
+}
+
+int son_open_fileno(son_t * h, int fd){
+	//open for read only -- stack is not used
+	if( son_phy_open_fileno(&(h->phy), fd) < 0 ){
+		h->err = SON_ERR_OPEN_IO;
+		return -1;
+	}
+	return open_from_phy(h);
+}
+
+int son_doc_open(son_doc_t * doc, const char * name){
+	if( son_phy_open_mmap(&(doc->phy), name, SON_MMAP_ADVICE_NORMAL) < 0 ){
+		return -1;
+	}
+	return doc_from_phy(doc);
+}
+
+int son_doc_open_message(son_doc_t * doc, const void * message, int nbyte){
+	if( son_phy_open_message(&(doc->phy), (void*)message, nbyte) < 0 ){
+		return -1;
+	}
+	return doc_from_phy(doc);
+}
+
+int son_doc_close(son_doc_t * doc){
+	return son_local_doc_release(doc);
+}
+
+int son_open_doc(son_t * h, son_doc_t * doc){
+	u32 ref_count;
+
+	//take a reference only while the document is still held by someone (the memory is gone at zero)
+	ref_count = __atomic_load_n(&(doc->ref_count), __ATOMIC_ACQUIRE);
+	do {
+		if( ref_count == 0 ){
+			h->err = SON_ERR_DOCUMENT_CLOSED;
+			return -1;
+		}
+	} while( __atomic_compare_exchange_n(&(doc->ref_count), &ref_count, ref_count + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE) == 0 );
+
+	if( son_phy_open_message(&(h->phy), doc->phy.message, doc->phy.message_size) < 0 ){
+		son_local_doc_release(doc);
+		h->err = SON_ERR_OPEN_IO;
+		return -1;
+	}
+
+	//the memory belongs to the document -- the handle can only read it
+	h->phy.message_size = doc->phy.message_size;
+	h->phy.o_flags = SON_PHY_FLAG_READ_ONLY;
+	son_phy_lseek(&(h->phy), sizeof(son_hdr_t), SON_SEEK_SET);
+
+	//the header was checked when the document was opened
+	h->doc = doc;
+	h->o_flags = doc->o_flags;
+	h->err = 0;
+	h->stack_loc = 0;
+	h->stack = 0;
+	h->stack_size = 0;
+
+	son_local_assign_checksum(h);
+	return 0;
+}
+
 int son_open_message(son_t * h, void * message, int nbyte){
 	//open for read only -- stack is not used
 	if( son_phy_open_message(&(h->phy), message, nbyte) < 0 ){
@@ -164,15 +433,34 @@ int son_seek(son_t * h, const char * access, son_size_t * data_size){
 
 int son_seek_next(son_t * h, char * name, son_value_t * type){
 	son_store_t store;
-	u32 next;
+	son_size_t next;
 	int ret = 0;
-	int current;
+	son_size_t current;
+	son_size_t end = 0;
 	u8 tmp;
 
 	if( son_local_verify_checksum(h) < 0 ){ return 0; }
 
 	current = son_local_phy_lseek_current(h, 0);
-	if( son_local_store_read(h, &store) > 0 ){
+
+	//the CRC follows the root so the scan must stop at the end of the root
+	if( h->o_flags & SON_FLAG_CRC ){
+		if( root_end(h, &end) < 0 ){
+			son_local_assign_checksum(h);
+			return 0;
+		}
+		son_local_phy_lseek_set(h, current);
+	}
+
+	while( ((end == 0) || (son_local_phy_lseek_current(h, 0) < end)) && (son_local_store_read(h, &store) > 0) ){
+		next = son_local_store_next(&store);
+
+		if( son_local_store_flags(&store) & SON_STORE_FLAG_INDEX ){
+			//indexes are not visible to readers
+			son_local_phy_lseek_set(h, next);
+			continue;
+		}
+
 		tmp = son_local_store_type(&store);
 		if( type ){ *type = tmp; }
 
@@ -184,10 +472,9 @@ int son_seek_next(son_t * h, char * name, son_value_t * type){
 		}
 
 		//The file needs to seek to the next sibling so the next call works
-		next = son_local_store_next(&store);
 		son_local_phy_lseek_set(h, next);
 		ret = next - current; //size of the advance
-
+		break;
 	}
 
 	son_local_assign_checksum(h);
@@ -196,8 +483,10 @@ int son_seek_next(son_t * h, char * name, son_value_t * type){
 
 int son_to_json(son_t * h, const char * path, int (*callback)(void*, const char *), void * context){
 	int is_array;
+	int ret;
 	son_store_t store;
 	son_phy_t phy;
+	json_writer_t w;
 	u8 type;
 
 
@@ -219,27 +508,38 @@ int son_to_json(son_t * h, const char * path, int (*callback)(void*, const char
 		return -1;
 	}
 
+	w.phy = 0;
+	w.callback = callback;
+	w.context = context;
+	w.is_compact = (h->o_flags & SON_FLAG_JSON_COMPACT) != 0;
+	w.len = 0;
+
 	//create a new file
 	if( path != 0 ){
 		if( son_phy_open(&phy, path, SON_O_CREAT | SON_O_RDWR | SON_O_TRUNC, 0666) < 0 ){
 			h->err = SON_ERR_OPEN_IO;
 			return -1;
 		}
+		w.phy = &phy;
+	}
 
-		phy_fprintf(&phy, callback, context, "{\n");
-		to_json_recursive(h, son_local_store_next(&store), 1, is_array, &phy, callback, context);
-		phy_fprintf(&phy, callback, context, "}\n");
+	json_puts(&w, "{");
+	json_newline(&w);
+	ret = to_json_traverse(h, son_local_store_next(&store), is_array, &w);
+	json_puts(&w, "}");
+	json_newline(&w);
+	json_flush(&w);
 
-		return son_phy_close(&phy);
-	} else {
-		phy_fprintf(0, callback, context, "{\n");
-		to_json_recursive(h, son_local_store_next(&store), 1, is_array, 0, callback, context);
-		phy_fprintf(0, callback, context, "}\n");
+	if( path != 0 ){
+		if( son_phy_close(&phy) < 0 ){
+			ret = -1;
+		}
 	}
 
-	return 0;
+	return ret;
 }
 
+#if SON_HANDLE_CHECKSUM
 void son_local_assign_checksum(son_t * h){
 	cortexm_assign_zero_sum32(h, CORTEXM_ZERO_SUM32_COUNT(son_t));
 }
@@ -251,6 +551,7 @@ int son_local_verify_checksum(son_t * h){
 	}
 	return 0;
 }
+#endif
 
 void son_local_store_insert_key(son_store_t * son, const char * key){
 	memset(son->key.name, 0, SON_KEY_NAME_CAPACITY);
@@ -259,26 +560,73 @@ void son_local_store_insert_key(son_store_t * son, const char * key){
 
 int son_local_store_read(son_t * h, son_store_t * store){
 	int ret;
+	int size = son_local_store_size(h);
 
-	ret = son_phy_read(&(h->phy), store, sizeof(son_store_t));
+	//compact documents don't have the upper bits
+	store->page_high = 0;
+	ret = son_phy_read(&(h->phy), store, size);
 
 	if( ret < 0 ){
 		h->err = SON_ERR_READ_IO;
 		return -1;
 	}
 
-	if( son_local_store_calc_checksum(store) != 0 ){
+	//a verified document was checked as a whole
+	if( ((h->o_flags & SON_LOCAL_FLAG_VERIFIED) == 0) &&
+			(son_local_store_calc_checksum(store) != 0) ){
 		h->err = SON_ERR_READ_CHECKSUM;
 		return -1;
 	}
 
-	return (ret == sizeof(son_store_t));
+	return (ret == size);
 }
 
 int son_local_store_write(son_t * h, son_store_t * store){
+	int size = son_local_store_size(h);
+
+	if( (store->page_high != 0) && (size != sizeof(son_store_t)) ){
+		h->err = SON_ERR_FILE_TOO_LARGE;
+		return -1;
+	}
+
 	store_set_checksum(store);
 
-	if( son_phy_write(&(h->phy), store, sizeof(son_store_t)) != sizeof(son_store_t) ){
+	if( son_phy_write(&(h->phy), store, size) != size ){
+		h->err = SON_ERR_WRITE_IO;
+		return -1;
+	}
+	return 0;
+}
+
+int son_local_store_write_value(son_t * h, son_store_t * store, const void * v, son_size_t size){
+	u8 buffer[sizeof(son_store_t) + SON_WRITE_GATHER_SIZE];
+	int store_size = son_local_store_size(h);
+
+	if( size > SON_WRITE_GATHER_SIZE ){
+		//large values are written straight from the caller's memory
+		if( son_local_store_write(h, store) < 0 ){
+			return -1;
+		}
+		if( son_phy_write(&(h->phy), v, size) != (int)size ){
+			h->err = SON_ERR_WRITE_IO;
+			return -1;
+		}
+		return 0;
+	}
+
+	if( (store->page_high != 0) && (store_size != sizeof(son_store_t)) ){
+		h->err = SON_ERR_FILE_TOO_LARGE;
+		return -1;
+	}
+
+	//small values go out with the store in a single write
+	store_set_checksum(store);
+	memcpy(buffer, store, store_size);
+	if( size > 0 ){
+		memcpy(buffer + store_size, v, size);
+	}
+
+	if( son_phy_write(&(h->phy), buffer, store_size + size) != (int)(store_size + size) ){
 		h->err = SON_ERR_WRITE_IO;
 		return -1;
 	}
@@ -308,7 +656,8 @@ u32 son_local_store_calc_checksum(son_store_t * store){
 }
 
 int open_from_phy(son_t * h){
-	if( son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0 ){
+	h->doc = 0;
+	if( read_header(h) < 0 ){
 		return -1;
 	}
 
@@ -317,11 +666,19 @@ int open_from_phy(son_t * h){
 	h->stack_size = 0;
 
 	son_local_assign_checksum(h);
+
+	//documents in memory (messages and mapped files) are checked once so the reads can skip the value checksums
+	if( (h->o_flags & SON_FLAG_CRC) && (h->phy.message != 0) && (son_verify(h) < 0) ){
+		//the values are checked as they are read instead (the memory may not hold the document yet)
+		h->err = 0;
+		son_local_assign_checksum(h);
+	}
 	return 0;
 }
 
 int edit_from_phy(son_t * h){
-	if( son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0 ){
+	h->doc = 0;
+	if( read_header(h) < 0 ){
 		return -1;
 	}
 
@@ -335,11 +692,10 @@ int edit_from_phy(son_t * h){
 }
 
 int create_from_phy(son_t * h, son_stack_t * stack, size_t stack_size){
-	son_hdr_t hdr;
-	hdr.version = SON_VERSION;
-
-	if( son_phy_write(&(h->phy), &hdr, sizeof(hdr)) != sizeof(hdr) ){
-		h->err = SON_ERR_WRITE_IO;
+	//new documents use the compact format unless SON_FLAG_LARGE is set before the root is opened
+	h->doc = 0;
+	h->o_flags = 0;
+	if( write_header(h) < 0 ){
 		son_phy_close(&(h->phy));
 		return -1;
 	}
@@ -352,31 +708,211 @@ int create_from_phy(son_t * h, son_stack_t * stack, size_t stack_size){
 	return 0;
 }
 
-char * is_token_array(char * tok, son_size_t * index){
-	char * arr;
-	arr = strchr(tok, '[');
-	if( arr == 0 ){
-		return 0;
+int read_header(son_t * h){
+	son_hdr_t hdr;
+
+	//older documents don't check the header -- anything that isn't marked large is compact
+	h->o_flags = 0;
+	if( son_local_phy_lseek_set(h, 0) < 0 ){
+		return -1;
 	}
-#if !defined __StratifyOS__
-	sscanf(arr, "[%d]", index);
-#else
-	sscanf(arr, "[%ld]", index);
-#endif
 
+	if( son_phy_read(&(h->phy), &hdr, sizeof(hdr)) == sizeof(hdr) ){
+		if( hdr.version & SON_HDR_FLAG_LARGE ){
+			h->o_flags |= SON_FLAG_LARGE;
+		}
+		if( hdr.version & SON_HDR_FLAG_CRC ){
+			h->o_flags |= SON_FLAG_CRC;
+		}
+	}
+
+	if( son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0 ){
+		return -1;
+	}
+	return 0;
+}
+
+int doc_from_phy(son_doc_t * doc){
+	son_t h;
+
+	//son_open_doc() fails until the document is ready
+	doc->ref_count = 0;
+
+	//read the header and check the CRC once using a temporary handle
+	if( (son_phy_open_message(&(h.phy), doc->phy.message, doc->phy.message_size) < 0) ||
+			(read_header(&h) < 0) ){
+		son_phy_close(&(doc->phy));
+		return -1;
+	}
+	h.phy.message_size = doc->phy.message_size;
+	h.stack = 0;
+	h.stack_size = 0;
+	h.stack_loc = 0;
+	son_local_assign_checksum(&h);
+
+	if( (h.o_flags & SON_FLAG_CRC) && (son_verify(&h) < 0) ){
+		son_phy_close(&(doc->phy));
+		return -1;
+	}
+
+	doc->o_flags = h.o_flags;
+	//the opener holds the first reference
+	doc->ref_count = 1;
+	return 0;
+}
+
+int son_local_doc_release(son_doc_t * doc){
+	//the last reference unmaps or frees the memory
+	if( __atomic_sub_fetch(&(doc->ref_count), 1, __ATOMIC_ACQ_REL) == 0 ){
+		return son_phy_close(&(doc->phy));
+	}
+	return 0;
+}
+
+int write_header(son_t * h){
+	son_hdr_t hdr;
+	hdr.version = SON_VERSION;
+	hdr.resd = 0;
+	if( h->o_flags & SON_FLAG_LARGE ){
+		hdr.version |= SON_HDR_FLAG_LARGE;
+	}
+	if( h->o_flags & SON_FLAG_CRC ){
+		hdr.version |= SON_HDR_FLAG_CRC;
+	}
+
+	if( son_phy_write(&(h->phy), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+		h->err = SON_ERR_WRITE_IO;
+		return -1;
+	}
+	return 0;
+}
+
+int son_path_compile(son_path_t * path, const char * access){
+	return path_compile(path, access) == SON_ERR_NONE ? 0 : -1;
+}
+
+int path_add_step(son_path_t * path, const char * key, int len, u32 index){
+	son_path_step_t * step;
+	if( path->count == SON_PATH_STEP_COUNT ){
+		return -1;
+	}
+
+	step = path->step + path->count;
+	memset(step->key, 0, SON_KEY_NAME_CAPACITY);
+	if( key ){
+		//keys longer than the max are truncated just like when they are written
+		memcpy(step->key, key, len < SON_KEY_NAME_SIZE ? len : SON_KEY_NAME_SIZE);
+	}
+	step->index = index;
+	path->count++;
+	return 0;
+}
+
+int path_compile(son_path_t * path, const char * access){
+	const char * start;
+	u32 index;
+
+	path->count = 0;
+
+	if( access == 0 ){
+		return SON_ERR_NONE;
+	}
+
+	if( strnlen(access, SON_ACCESS_NAME_SIZE) > (SON_ACCESS_MAX_USER_SIZE) ){
+		return SON_ERR_ACCESS_TOO_LONG;
+	}
+
+	//peel off object names or index values
+	while( *access != 0 ){
+		start = access;
+		while( (*access != 0) && (*access != '.') && (*access != '[') ){
+			access++;
+		}
+
+		//empty keys between periods are skipped (e.g. "a..b" is the same as "a.b")
+		if( (access != start) || (*access == '[') ){
+			if( path_add_step(path, start, access - start, SON_PATH_KEY) < 0 ){
+				return SON_ERR_ACCESS_TOO_LONG;
+			}
+		}
+
+		while( *access == '[' ){
+			access++;
+			if( (*access < '0') || (*access > '9') ){
+				return SON_ERR_INVALID_ACCESS;
+			}
+
+			index = 0;
+			while( (*access >= '0') && (*access <= '9') ){
+				index = index*10 + (*access - '0');
+				access++;
+			}
+
+			if( *access != ']' ){
+				return SON_ERR_INVALID_ACCESS;
+			}
+			access++;
+
+			if( path_add_step(path, 0, 0, index) < 0 ){
+				return SON_ERR_ACCESS_TOO_LONG;
+			}
+		}
+
+		if( *access == '.' ){
+			access++;
+		} else if( *access != 0 ){
+			return SON_ERR_INVALID_ACCESS;
+		}
+	}
+
+	return SON_ERR_NONE;
+}
+
+int son_local_path_compile(son_t * h, son_path_t * path, const char * access){
+	int err;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	err = path_compile(path, access);
+	if( err != SON_ERR_NONE ){
+		h->err = err;
+		son_local_assign_checksum(h);
+		return -1;
+	}
 
-	arr[0] = 0;
-	return arr + 1;
+	son_local_assign_checksum(h);
+	return 0;
 }
 
-int seek_array_key(son_t * h, son_size_t ind, son_store_t * store, son_size_t * size){
+int seek_array_key(son_t * h, const son_store_t * parent, son_size_t ind, son_store_t * store, son_size_t * size){
 	son_size_t pos;
 	son_size_t i;
 	son_size_t next;
+	son_size_t end;
+	int ret;
+
+	if( parent &&
+			(son_local_store_type(parent) == SON_ARRAY) &&
+			(son_local_store_flags(parent) & SON_STORE_FLAG_INDEXED) ){
+		//jump to the closest element in the table then walk the rest
+		ret = seek_array_table(h, parent, &ind);
+		if( ret == 0 ){
+			return 0;
+		}
+	}
 
 	pos = son_local_phy_lseek_current(h, 0);
 
-	for(i=0; i <= ind; i++){
+	//the elements end with the parent (zero if the parent isn't closed)
+	end = parent ? son_local_store_next(parent) : 0;
+
+	i = 0;
+	while( i <= ind ){
+
+		if( end && (son_local_phy_lseek_current(h, 0) >= end) ){
+			h->err = SON_ERR_ARRAY_INDEX_NOT_FOUND;
+			return 0;
+		}
 
 		if( son_local_store_read(h, store) <= 0 ){
 			//this is an error which is set by store_read()
@@ -392,9 +928,16 @@ int seek_array_key(son_t * h, son_size_t ind, son_store_t * store, son_size_t *
 			return 0;
 		}
 
+		if( son_local_store_flags(store) & SON_STORE_FLAG_INDEX ){
+			//index stores are not elements
+			son_local_phy_lseek_set(h, next);
+			continue;
+		}
+
 		if( i != ind ){
 			son_local_phy_lseek_set(h, next);
 		}
+		i++;
 	}
 
 	*size = son_local_store_next(store) - pos;
@@ -405,15 +948,175 @@ int seek_array_key(son_t * h, son_size_t ind, son_store_t * store, son_size_t *
 	return 0;
 }
 
-int seek_key(son_t * h, const char * name, son_store_t * ob, son_size_t * size){
+int seek_array_table(son_t * h, const son_store_t * parent, son_size_t * ind){
+	son_index_trailer_t trailer;
+	son_size_t start;
+	son_size_t end;
+	u32 entries;
+	u32 offset;
+
+	//returns 1 if positioned, 0 if the index is out of range and -1 if the table can't be used
+	start = son_local_phy_lseek_current(h, 0);
+	end = son_local_store_next(parent);
+
+	if( end < start + son_local_store_size(h) + sizeof(trailer) ){
+		return -1;
+	}
+
+	if( (son_local_phy_lseek_set(h, end - sizeof(trailer)) < 0) ||
+			(son_phy_read(&(h->phy), &trailer, sizeof(trailer)) != sizeof(trailer)) ){
+		son_local_phy_lseek_set(h, start);
+		return -1;
+	}
+
+	if( (trailer.stride == 0) || (trailer.count == 0) ){
+		//not an array table
+		son_local_phy_lseek_set(h, start);
+		return -1;
+	}
+
+	entries = (trailer.count + trailer.stride - 1) / trailer.stride;
+	if( entries > (end - start - son_local_store_size(h) - sizeof(trailer)) / sizeof(u32) ){
+		son_local_phy_lseek_set(h, start);
+		return -1;
+	}
+
+	if( *ind >= trailer.count ){
+		h->err = SON_ERR_ARRAY_INDEX_NOT_FOUND;
+		return 0;
+	}
+
+	if( (son_local_phy_lseek_set(h, end - sizeof(trailer) - (entries - *ind / trailer.stride)*sizeof(u32)) < 0) ||
+			(son_phy_read(&(h->phy), &offset, sizeof(offset)) != sizeof(offset)) ){
+		h->err = SON_ERR_READ_IO;
+		return 0;
+	}
+
+	//the parent store is right before the first element
+	if( (offset < son_local_store_size(h)) ||
+			(son_local_phy_lseek_set(h, start - son_local_store_size(h) + offset) < 0) ){
+		h->err = SON_ERR_ARRAY_INDEX_NOT_FOUND;
+		return 0;
+	}
+
+	*ind = *ind % trailer.stride;
+	return 1;
+}
+
+u32 son_local_key_hash(const u8 * key){
+	//FNV-1a over the zero padded key
+	u32 hash = 2166136261UL;
+	u32 i;
+	for(i=0; i < SON_KEY_NAME_CAPACITY; i++){
+		hash ^= key[i];
+		hash *= 16777619UL;
+	}
+	return hash;
+}
+
+int seek_key_index(son_t * h, const son_store_t * parent, const char * name, son_store_t * ob, son_size_t * size){
+	son_store_t store;
+	son_index_trailer_t trailer;
+	son_index_slot_t slot;
+	son_size_t start;
+	son_size_t end;
+	son_size_t slots;
+	u32 hash;
+	u32 i;
+	u32 probe;
+
+	//returns 1 if found, 0 if not found and -1 if the index can't be used
+	start = son_local_phy_lseek_current(h, 0);
+	end = son_local_store_next(parent);
+
+	if( end < start + son_local_store_size(h) + sizeof(trailer) ){
+		return -1;
+	}
+
+	if( (son_local_phy_lseek_set(h, end - sizeof(trailer)) < 0) ||
+			(son_phy_read(&(h->phy), &trailer, sizeof(trailer)) != sizeof(trailer)) ){
+		return -1;
+	}
+
+	if( (trailer.stride != 0) ||
+			(trailer.count == 0) ||
+			(trailer.count & (trailer.count-1)) ||
+			(trailer.count > (end - start - son_local_store_size(h) - sizeof(trailer)) / sizeof(son_index_slot_t)) ){
+		return -1;
+	}
+
+	slots = end - sizeof(trailer) - trailer.count*sizeof(son_index_slot_t);
+	hash = son_local_key_hash((const u8*)name);
+	i = hash & (trailer.count - 1);
+
+	for(probe=0; probe < trailer.count; probe++){
+		if( (son_local_phy_lseek_set(h, slots + i*sizeof(slot)) < 0) ||
+				(son_phy_read(&(h->phy), &slot, sizeof(slot)) != sizeof(slot)) ){
+			h->err = SON_ERR_READ_IO;
+			return 0;
+		}
+
+		if( slot.offset == 0 ){
+			//an empty slot ends the probe sequence
+			break;
+		}
+
+		if( slot.hash == hash ){
+			//the parent store is right before the first member
+			if( son_local_phy_lseek_set(h, start - son_local_store_size(h) + slot.offset) < 0 ){
+				return 0;
+			}
+
+			if( son_local_store_read(h, &store) <= 0 ){
+				return 0;
+			}
+
+			if( memcmp(name, store.key.name, SON_KEY_NAME_CAPACITY) == 0 ){
+				*size = son_local_store_next(&store) - (start + slot.offset);
+				*ob = store;
+				return 1;
+			}
+		}
+
+		i = (i+1) & (trailer.count - 1);
+	}
+
+	h->err = SON_ERR_KEY_NOT_FOUND;
+	return 0;
+}
+
+int seek_key(son_t * h, const son_store_t * parent, const char * name, son_store_t * ob, son_size_t * size){
 	son_store_t store;
-	size_t pos;
-	u32 next;
+	son_size_t pos;
+	son_size_t next;
+	son_size_t end;
 	int ret;
 
 	*size = 0;
 
-	while( (ret = son_local_store_read(h, &store)) > 0 ){
+	if( parent && (son_local_store_flags(parent) & SON_STORE_FLAG_INDEXED) && (son_local_store_type(parent) == SON_OBJ) ){
+		pos = son_local_phy_lseek_current(h, 0);
+		ret = seek_key_index(h, parent, name, ob, size);
+		if( ret >= 0 ){
+			return ret;
+		}
+
+		//the index isn't valid -- scan the members instead
+		son_local_phy_lseek_set(h, pos);
+	}
+
+	//the members end with the parent (the root is the only value at the top)
+	end = parent ? son_local_store_next(parent) : 0;
+
+	while( (end == 0) || (son_local_phy_lseek_current(h, 0) < end) ){
+
+		ret = son_local_store_read(h, &store);
+		if( ret <= 0 ){
+			if( ret == 0 ){
+				h->err = SON_ERR_KEY_NOT_FOUND;
+			}
+			return 0;
+		}
 
 		next = son_local_store_next(&store);
 
@@ -424,6 +1127,12 @@ int seek_key(son_t * h, const char * name, son_store_t * ob, son_size_t * size){
 			return 0;
 		}
 
+		if( son_local_store_flags(&store) & SON_STORE_FLAG_INDEX ){
+			//indexes are not visible to readers
+			son_local_phy_lseek_set(h, next);
+			continue;
+		}
+
 		pos = son_local_phy_lseek_current(h, 0);
 
 		//if next is 0, then the object hasn't been closed yet (and must be an array or object marker)
@@ -431,7 +1140,8 @@ int seek_key(son_t * h, const char * name, son_store_t * ob, son_size_t * size){
 			*size = next - pos;
 		}
 
-		if( strncmp(name, (char*)store.key.name, SON_KEY_NAME_SIZE) == 0 ){
+		//keys are zero padded so the whole key can be compared at once
+		if( memcmp(name, store.key.name, SON_KEY_NAME_CAPACITY) == 0 ){
 			*ob = store;
 			return 1;
 		}
@@ -441,27 +1151,39 @@ int seek_key(son_t * h, const char * name, son_store_t * ob, son_size_t * size){
 			son_local_phy_lseek_set(h, next);
 		}
 
+		if( parent == 0 ){
+			end = next;
+		}
 	}
 
-	if( ret == 0 ){
-		h->err = SON_ERR_KEY_NOT_FOUND;
-	}
+	h->err = SON_ERR_KEY_NOT_FOUND;
 	return 0;
 }
 
 int son_local_store_seek(son_t * h, const char * access, son_store_t * son, son_size_t * data_size){
-	char acc[SON_ACCESS_NAME_CAPACITY];
-	char * str;
-	char * tok;
-	char * nested_array_tok;
-	char acc_item[SON_ACCESS_NAME_CAPACITY];
-	son_size_t ind;
+	son_path_t path;
+	int err;
+
+	err = path_compile(&path, access);
+	if( err != SON_ERR_NONE ){
+		h->err = err;
+		return -1;
+	}
+
+	return son_local_store_seek_path(h, &path, son, data_size);
+}
+
+int son_local_store_seek_path(son_t * h, const son_path_t * path, son_store_t * son, son_size_t * data_size){
+	static const char root_key[SON_KEY_NAME_CAPACITY] = "$";
+	const son_path_step_t * step;
+	son_store_t parent;
+	u32 i;
 
 	if( son_local_phy_lseek_set(h, sizeof(son_hdr_t)) < 0 ){
 		return -1;
 	}
 
-	if( (access == 0) || (access[0] == 0) ){
+	if( path->count == 0 ){
 		//return the root value
 		if( son_local_store_read(h, son) < 0 ){
 			return -1;
@@ -470,45 +1192,22 @@ int son_local_store_seek(son_t * h, const char * access, son_store_t * son, son_
 		return 0;
 	}
 
-	if( strnlen(access, SON_ACCESS_NAME_SIZE) > (SON_ACCESS_MAX_USER_SIZE) ){
-		h->err = SON_ERR_ACCESS_TOO_LONG;
+	if( seek_key(h, 0, root_key, son, data_size) == 0 ){
 		return -1;
 	}
 
-	strncpy(acc, "$.", SON_ACCESS_NAME_SIZE);
-	strncat(acc, access, SON_ACCESS_NAME_SIZE - 2);
-
-	//! \todo Need to check and see if the access string is too large
-
-	str = acc;
-
-	//peel off object names or index values
-	while( (tok = strtok_r(str, ".", &str)) != 0 ){
-
-		strncpy(acc_item, tok, SON_ACCESS_NAME_SIZE);
-
-		if( (nested_array_tok = is_token_array(acc_item, &ind)) != 0 ){
-
-			//search for token then array index
-			if( seek_key(h, acc_item, son, data_size) ){
-
-				do {
-					//now find the array object
-					if( seek_array_key(h, ind, son, data_size) == 0){
-						return -1;
-					}
-
-					nested_array_tok = is_token_array(nested_array_tok, &ind);
-
-				} while( nested_array_tok != 0 );
-
-			} else {
+	for(i=0; i < path->count; i++){
+		step = path->step + i;
+		if( step->index == SON_PATH_KEY ){
+			//search for the key (the parent may have an index)
+			parent = *son;
+			if( seek_key(h, &parent, step->key, son, data_size) == 0 ){
 				return -1;
 			}
-
 		} else {
-			//search for token
-			if( seek_key(h, tok, son, data_size) == 0 ){
+			//now find the array object (the parent may have an offset table)
+			parent = *son;
+			if( seek_array_key(h, &parent, step->index, son, data_size) == 0 ){
 				return -1;
 			}
 		}
@@ -517,39 +1216,101 @@ int son_local_store_seek(son_t * h, const char * access, son_store_t * son, son_
 	return 0;
 }
 
-void print_indent(int indent, son_phy_t * phy, son_to_json_callback_t callback, void * context){
-	int i;
-	for(i=0; i < indent; i++){ phy_fputs(phy, callback, context, " "); }
-}
+void json_flush(json_writer_t * w){
+	if( w->len == 0 ){
+		return;
+	}
+
+	w->buffer[w->len] = 0;
+	if( w->phy != 0 ){
+		son_phy_write(w->phy, w->buffer, w->len);
+	}
 
-void phy_fputs(son_phy_t * phy, son_to_json_callback_t callback, void * context, const char * str){
-	if( phy != 0 ){
-		son_phy_write(phy, str, strlen(str));
+	if( w->callback != 0 ){
+		w->callback(w->context, w->buffer);
 	}
+	w->len = 0;
+}
+
+void json_write(json_writer_t * w, const char * str, u32 nbyte){
+	u32 page;
+	while( nbyte > 0 ){
+		if( w->len == SON_JSON_BUFFER_SIZE ){
+			json_flush(w);
+		}
+
+		page = SON_JSON_BUFFER_SIZE - w->len;
+		if( page > nbyte ){
+			page = nbyte;
+		}
 
-	if( callback != 0 ){
-		callback(context, str);
+		memcpy(w->buffer + w->len, str, page);
+		w->len += page;
+		str += page;
+		nbyte -= page;
 	}
 }
 
-void phy_fprintf(son_phy_t * phy, son_to_json_callback_t callback, void * context, const char * format, ...){
-	char buffer[128];
+void json_puts(json_writer_t * w, const char * str){
+	json_write(w, str, strlen(str));
+}
+
+void json_printf(json_writer_t * w, const char * format, ...){
 	va_list args;
+	int len;
+
+	//only used for short tokens (numbers and keys) which always fit
+	if( SON_JSON_BUFFER_SIZE - w->len < 64 ){
+		json_flush(w);
+	}
+
 	va_start (args, format);
-	vsnprintf(buffer, 128, format, args);
+	len = vsnprintf(w->buffer + w->len, SON_JSON_BUFFER_SIZE - w->len + 1, format, args);
 	va_end (args);
 
-	if( phy != 0 ){
-		son_phy_write(phy, buffer, strnlen(buffer, 128));
+	if( len > 0 ){
+		if( len > (int)(SON_JSON_BUFFER_SIZE - w->len) ){
+			len = SON_JSON_BUFFER_SIZE - w->len;
+		}
+		w->len += len;
 	}
+}
+
+void json_indent(json_writer_t * w, int indent){
+	u32 page;
 
-	if( callback != 0 ){
-		callback(context, buffer);
+	if( w->is_compact ){
+		return;
+	}
+
+	while( indent > 0 ){
+		if( w->len == SON_JSON_BUFFER_SIZE ){
+			json_flush(w);
+		}
+
+		page = SON_JSON_BUFFER_SIZE - w->len;
+		if( page > (u32)indent ){
+			page = indent;
+		}
+
+		memset(w->buffer + w->len, ' ', page);
+		w->len += page;
+		indent -= page;
 	}
 }
 
-int son_local_phy_lseek_current(son_t * h, s32 offset){
-	int ret;
+void json_newline(json_writer_t * w){
+	if( w->is_compact == 0 ){
+		json_write(w, "\n", 1);
+	}
+}
+
+void json_key(json_writer_t * w, const u8 * key){
+	json_printf(w, w->is_compact ? "\"%s\":" : "\"%s\" : ", key);
+}
+
+son_phy_off_t son_local_phy_lseek_current(son_t * h, son_phy_off_t offset){
+	son_phy_off_t ret;
 	ret = son_phy_lseek(&(h->phy), offset, SON_SEEK_CUR);
 	if( ret < 0 ){
 		h->err = SON_ERR_SEEK_IO;
@@ -557,8 +1318,8 @@ int son_local_phy_lseek_current(son_t * h, s32 offset){
 	return ret;
 }
 
-int son_local_phy_lseek_set(son_t * h, s32 offset){
-	int ret;
+son_phy_off_t son_local_phy_lseek_set(son_t * h, son_phy_off_t offset){
+	son_phy_off_t ret;
 	ret = son_phy_lseek(&(h->phy), offset, SON_SEEK_SET);
 	if( ret < 0 ){
 		h->err = SON_ERR_SEEK_IO;
@@ -566,171 +1327,240 @@ int son_local_phy_lseek_set(son_t * h, s32 offset){
 	return ret;
 }
 
-void to_json_recursive(son_t * h,
+int to_json_traverse(son_t * h,
 		son_size_t last_pos,
-		int indent,
 		int is_array,
-		son_phy_t * phy,
-		son_to_json_callback_t callback,
-		void * context){
+		json_writer_t * w){
+	json_frame_t stack[SON_JSON_DEPTH_MAX];
+	json_frame_t * frame;
 	son_store_t store;
 	son_size_t data_size;
 	son_size_t pos;
 	son_size_t next;
+	int depth;
 	u8 type;
 
+	//the stack is explicit so that deep documents don't use more memory
+	stack[0].last_pos = last_pos;
+	stack[0].is_array = is_array;
+	stack[0].is_first = 1;
+	stack[0].is_done = 0;
+	depth = 1;
 
-	while( son_local_store_read(h, &store) > 0 ){
+	while( depth > 0 ){
+		frame = stack + depth - 1;
+
+		if( (frame->is_done == 0) && (son_local_store_read(h, &store) <= 0) ){
+			frame->is_done = 1;
+		}
+
+		if( frame->is_done ){
+			//close the object or array
+			json_newline(w);
+			depth--;
+			if( depth > 0 ){
+				json_indent(w, depth);
+				json_puts(w, frame->is_array ? "]" : "}");
+			}
+			continue;
+		}
 
 		pos = son_local_phy_lseek_current(h, 0);
 		next = son_local_store_next(&store);
 		data_size = next - pos;
 		type = son_local_store_type(&store);
 
-		print_indent(indent, phy, callback, context);
-		if( type == SON_OBJ ){
+		if( next == frame->last_pos ){
+			//this is the last member
+			frame->is_done = 1;
+		}
 
-			if( is_array ){
-				phy_fputs(phy, callback, context, "{\n");
-			} else {
-				phy_fprintf(phy, callback, context, "\"%s\" : {\n", store.key.name);
-			}
-			if( data_size > 0 ){
-				to_json_recursive(h, next, indent+1, 0, phy, callback, context);
-			}
-			print_indent(indent, phy, callback, context);
-			phy_fputs(phy, callback, context, "}");
+		if( son_local_store_flags(&store) & SON_STORE_FLAG_INDEX ){
+			//indexes are not visible to readers
+			son_local_phy_lseek_set(h, next);
+			continue;
+		}
 
-		} else if( type == SON_ARRAY ){
+		//add a comma?
+		if( frame->is_first == 0 ){
+			json_puts(w, ",");
+			json_newline(w);
+		}
+		frame->is_first = 0;
 
-			if( is_array ){
-				phy_fputs(phy, callback, context, "[\n");
-			} else {
-				phy_fprintf(phy, callback, context, "\"%s\" : [\n", store.key.name);
-			}
+		json_indent(w, depth);
+		if( frame->is_array == 0 ){
+			json_key(w, store.key.name);
+		}
+
+		if( (type == SON_OBJ) || (type == SON_ARRAY) ){
+
+			json_puts(w, type == SON_ARRAY ? "[" : "{");
+			json_newline(w);
 			if( data_size > 0 ){
-				to_json_recursive(h, next, indent+1, 1, phy, callback, context);
+				if( depth == SON_JSON_DEPTH_MAX ){
+					h->err = SON_ERR_STACK_OVERFLOW;
+					return -1;
+				}
+
+				//descend in to the members
+				frame = stack + depth;
+				frame->last_pos = next;
+				frame->is_array = (type == SON_ARRAY);
+				frame->is_first = 1;
+				frame->is_done = 0;
+				depth++;
+			} else {
+				json_indent(w, depth);
+				json_puts(w, type == SON_ARRAY ? "]" : "}");
 			}
-			print_indent(indent, phy, callback, context);
-			phy_fputs(phy, callback, context, "]");
+
+		} else if( type == SON_TYPED_ARRAY ){
+
+			//packed arrays look just like regular arrays in JSON
+			json_puts(w, "[");
+			json_newline(w);
+			to_json_typed_array(h, data_size, depth+1, w);
+			son_local_phy_lseek_set(h, next);
+			json_indent(w, depth);
+			json_puts(w, "]");
 
 		} else {
-			char buffer[data_size+1];
-			buffer[data_size] = 0;
-			son_phy_read(&(h->phy), buffer, data_size);
+			to_json_value(h, type, data_size, w);
+			son_local_phy_lseek_set(h, next);
+		}
+	}
 
+	return 0;
+}
 
-			if( is_array == 0 ){
-				phy_fprintf(phy, callback, context, "\"%s\" : ", store.key.name);
+void to_json_value(son_t * h,
+		u8 type,
+		son_size_t data_size,
+		json_writer_t * w){
+	son_buffer_t value;
+	char data[SON_JSON_CHUNK_SIZE];
+	char chunk[SON_JSON_CHUNK_SIZE/3*4+1];
+	const char * end;
+	son_size_t remaining;
+	u32 page;
+
+	if( type == SON_STRING ){
+		//copy the string a chunk at a time up to the zero terminator
+		json_puts(w, "\"");
+		remaining = data_size;
+		while( remaining > 0 ){
+			page = remaining > SON_JSON_CHUNK_SIZE ? SON_JSON_CHUNK_SIZE : remaining;
+			if( son_phy_read(&(h->phy), data, page) != (int)page ){
+				break;
 			}
+			end = memchr(data, 0, page);
+			json_write(w, data, end ? (u32)(end - data) : page);
+			if( end ){
+				break;
+			}
+			remaining -= page;
+		}
+		json_puts(w, "\"");
+		return;
+	}
 
-			if( type == SON_STRING ){
-				phy_fputs(phy, callback, context, "\"");
-				phy_fputs(phy, callback, context, buffer);
-				phy_fputs(phy, callback, context, "\"");
-			} else if ( type == SON_FLOAT ){
-				float * value = (float*)buffer;
-				phy_fprintf(phy, callback, context, "%f", *value);
-			} else if ( type == SON_NUMBER_U32 ){
-				u32 * value = (u32*)buffer;
+	if( type == SON_DATA ){
+		//encode whole groups of three bytes so the chunks join without padding
+		json_puts(w, "\"");
+		remaining = data_size;
+		while( remaining > 0 ){
+			page = remaining > SON_JSON_CHUNK_SIZE ? SON_JSON_CHUNK_SIZE : remaining;
+			if( son_phy_read(&(h->phy), data, page) != (int)page ){
+				break;
+			}
+			json_write(w, chunk, son_local_base64_encode(chunk, data, page));
+			remaining -= page;
+		}
+		json_puts(w, "\"");
+		return;
+	}
+
+	//numbers are read in to an aligned buffer
+	value.n_u64 = 0;
+	if( data_size > 0 ){
+		son_phy_read(&(h->phy), value.cdata, data_size < sizeof(value.n_u64) ? data_size : sizeof(value.n_u64));
+	}
+
+	switch(type){
+	case SON_FLOAT: json_printf(w, "%f", *(float*)value.cdata); break;
 #if !defined __StratifyOS__
-				phy_fprintf(phy, callback, context, "%d", *value);
+	case SON_NUMBER_U32: json_printf(w, "%d", *(u32*)value.cdata); break;
+	case SON_NUMBER_S32: json_printf(w, "%d", *(s32*)value.cdata); break;
 #else
-				phy_fprintf(phy, callback, context, "%ld", *value);
+	case SON_NUMBER_U32: json_printf(w, "%ld", *(u32*)value.cdata); break;
+	case SON_NUMBER_S32: json_printf(w, "%ld", *(s32*)value.cdata); break;
 #endif
-			} else if ( type == SON_NUMBER_S32 ){
-				s32 * value = (s32*)buffer;
+	case SON_NUMBER_S64: json_printf(w, "%lld", (long long)(s64)value.n_u64); break;
+	case SON_NUMBER_U64: json_printf(w, "%llu", (unsigned long long)value.n_u64); break;
+	case SON_DOUBLE: json_printf(w, "%.17g", value.d); break;
+	case SON_TRUE: json_puts(w, "true"); break;
+	case SON_FALSE: json_puts(w, "false"); break;
+	case SON_NULL: json_puts(w, "null"); break;
+	}
+}
+
+void to_json_typed_array(son_t * h,
+		son_size_t data_size,
+		int indent,
+		json_writer_t * w){
+	son_typed_array_hdr_t hdr;
+	double buffer[8]; //aligned for any element type
+	u8 * element;
+	son_size_t count;
+	u32 n;
+	u32 i;
+	u32 j;
+
+	if( (data_size < sizeof(hdr)) ||
+			(son_phy_read(&(h->phy), &hdr, sizeof(hdr)) != sizeof(hdr)) ||
+			(hdr.size != son_local_array_type_size(hdr.type)) ){
+		return;
+	}
+
+	count = (data_size - sizeof(hdr)) / hdr.size;
+
+	//read the elements a chunk at a time
+	for(i=0; i < count; i += n){
+		n = sizeof(buffer) / hdr.size;
+		if( n > count - i ){
+			n = count - i;
+		}
+
+		if( son_phy_read(&(h->phy), buffer, n*hdr.size) != (int)(n*hdr.size) ){
+			return;
+		}
+
+		for(j=0; j < n; j++){
+			if( i + j > 0 ){
+				json_puts(w, ",");
+				json_newline(w);
+			}
+			json_indent(w, indent);
+
+			element = (u8*)buffer + j*hdr.size;
+			switch(hdr.type){
+			case SON_ARRAY_U8: json_printf(w, "%u", *element); break;
+			case SON_ARRAY_S16: json_printf(w, "%d", *(s16*)element); break;
 #if !defined __StratifyOS__
-				phy_fprintf(phy, callback, context, "%d", *value);
+			case SON_ARRAY_U32: json_printf(w, "%u", *(u32*)element); break;
+			case SON_ARRAY_S32: json_printf(w, "%d", *(s32*)element); break;
 #else
-				phy_fprintf(phy, callback, context, "%ld", *value);
+			case SON_ARRAY_U32: json_printf(w, "%lu", *(u32*)element); break;
+			case SON_ARRAY_S32: json_printf(w, "%ld", *(s32*)element); break;
 #endif
-			} else if ( type == SON_TRUE ){
-				phy_fputs(phy, callback, context, "true");
-			} else if ( type == SON_FALSE ){
-				phy_fputs(phy, callback, context, "false");
-			} else if ( type == SON_NULL ){
-				phy_fputs(phy, callback, context, "null");
-			} else if ( type == SON_DATA ){
-				//write base64 encoded data
-				int encoded_size = base64_calc_encoded_size(data_size);
-				char dest[encoded_size+1]; //add a byte for the zero terminator
-				base64_encode(dest, buffer, data_size);
-				phy_fputs(phy, callback, context, "\"");
-				phy_fputs(phy, callback, context, dest);
-				phy_fputs(phy, callback, context, "\"");
+			case SON_ARRAY_FLOAT: json_printf(w, "%f", *(float*)element); break;
+			case SON_ARRAY_DOUBLE: json_printf(w, "%.17g", *(double*)element); break;
 			}
 		}
-
-		//add a comma?
-		if( next != last_pos ){
-			phy_fprintf(phy, callback, context, ",\n");
-		} else {
-			phy_fprintf(phy, callback, context, "\n");
-			return;
-		}
 	}
-}
 
-int base64_encode(char * dest, const void * src, int nbyte){
-	int i;
-	int j;
-	int k;
-	int len;
-	uint8_t six_bits[4];
-	len = nbyte;
-	const char * data;
-	data = (const char *)src;
-
-	k = 0;
-	//We need to encode three bytes at a time in to four encoded bytes
-	for(i=0; i < len; i+=3){
-		//First the thress bytes are broken down into six-bit sections
-		six_bits[0] = (data[i] >> 2) & 0x3F;
-		six_bits[1] = ((data[i] << 4) & 0x30) + ((data[i+1]>>4) & 0x0F);
-		six_bits[2] = ((data[i+1] << 2) & 0x3C) + ((data[i+2]>>6) & 0x03);
-		six_bits[3] = data[i+2] & 0x3F;
-		//now we use the helper function to convert from six-bits to base64
-		for(j=0; j < 4; j++){
-			dest[k+j] = base64_encode_six(six_bits[j]);
-		}
-		k+=4;
-	}
-
-	//at the end, we add = if the input is not divisible by 3
-	if( (len % 3) == 1 ){
-		//two equals at end
-		dest[k-2] = '=';
-		dest[k-1] = '=';
-	} else if ( (len %3 ) == 2 ){
-		dest[k-1] = '=';
-	}
-
-	//finally, zero terminate the output string
-	dest[k] = 0;
-
-	return strlen(dest);
-}
-
-int base64_calc_encoded_size(int nbyte){
-	return ((((nbyte*4+2)/3) + 3)/4)*4;
-}
-
-//This is a helper function to convert a six-bit value to base64
-char base64_encode_six(uint8_t six_bit_value){
-	uint8_t x;
-	char c = -1;
-	x = six_bit_value & ~0xC0; //remove top two bits (should be zero anyway)
-	if( x < 26 ){
-		c = 'A' + x;
-	} else if ( x < 52 ){
-		c = 'a' + (x - 26);
-	} else if( x < 62 ){
-		c = '0' + (x - 52);
-	} else if( x == 62 ){
-		c = '+';
-	} else if (x == 63 ){
-		c = '/';
-	}
-	return c;
+	if( count > 0 ){
+		json_newline(w);
+	}
 }
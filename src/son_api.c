@@ -50,5 +50,57 @@ const son_api_t son_api = {
     .send_message = son_send_message,
     .recv_message = son_recv_message,
     .get_message_size = son_get_message_size,
-    .seek_next = son_seek_next
+    .seek_next = son_seek_next,
+    .set_cache = son_set_cache,
+    .read_view = son_read_view,
+    .path_compile = son_path_compile,
+    .read_str_path = son_read_str_path,
+    .read_num_path = son_read_num_path,
+    .read_unum_path = son_read_unum_path,
+    .read_float_path = son_read_float_path,
+    .read_data_path = son_read_data_path,
+    .read_bool_path = son_read_bool_path,
+    .read_view_path = son_read_view_path,
+    .set_flags = son_set_flags,
+    .write_array_u8 = son_write_array_u8,
+    .write_array_s16 = son_write_array_s16,
+    .write_array_u32 = son_write_array_u32,
+    .write_array_s32 = son_write_array_s32,
+    .write_array_float = son_write_array_float,
+    .write_array_double = son_write_array_double,
+    .read_array_u8 = son_read_array_u8,
+    .read_array_s16 = son_read_array_s16,
+    .read_array_u32 = son_read_array_u32,
+    .read_array_s32 = son_read_array_s32,
+    .read_array_float = son_read_array_float,
+    .read_array_double = son_read_array_double,
+    .write_num64 = son_write_num64,
+    .write_unum64 = son_write_unum64,
+    .write_double = son_write_double,
+    .read_num64 = son_read_num64,
+    .read_unum64 = son_read_unum64,
+    .read_double = son_read_double,
+    .read_num64_path = son_read_num64_path,
+    .read_unum64_path = son_read_unum64_path,
+    .read_double_path = son_read_double_path,
+    .edit_num64 = son_edit_num64,
+    .edit_unum64 = son_edit_unum64,
+    .edit_double = son_edit_double,
+    .from_json = son_from_json,
+    .set_write_buffer = son_set_write_buffer,
+    .doc_open_message = son_doc_open_message,
+    .doc_close = son_doc_close,
+    .open_doc = son_open_doc,
+    .verify = son_verify,
+    .init_message_buffer = son_init_message_buffer,
+    .recv_message_buffered = son_recv_message_buffered,
+    .init_message_decoder = son_init_message_decoder,
+    .feed_message_decoder = son_feed_message_decoder,
+    .send_messages = son_send_messages,
+    .get_ring_size = son_get_ring_size,
+    .init_ring = son_init_ring,
+    .create_ring_message = son_create_ring_message,
+    .send_ring_message = son_send_ring_message,
+    .recv_ring_message = son_recv_ring_message,
+    .release_ring_message = son_release_ring_message
 };
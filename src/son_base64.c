@@ -0,0 +1,242 @@
+/*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
+
+#include "son_local.h"
+
+#if defined __AVX2__
+#include <immintrin.h>
+#elif defined __SSSE3__
+#include <tmmintrin.h>
+#elif defined __ARM_NEON && defined __aarch64__
+#include <arm_neon.h>
+#endif
+
+#define BASE64_INVALID 0xff
+
+static const char encode_table[64+1] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz"
+		"0123456789+/";
+
+static const u8 decode_table[256] = {
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+		0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+		0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+		0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+static son_size_t encode_scalar(char * dest, const u8 * src, son_size_t nbyte);
+
+#if defined __SSSE3__ || defined __AVX2__
+static __m128i encode_ssse3_reshuffle(__m128i in);
+static __m128i encode_ssse3_translate(__m128i indices);
+#endif
+
+son_size_t son_local_base64_encoded_size(son_size_t nbyte){
+	return ((nbyte + 2) / 3) * 4;
+}
+
+son_size_t son_local_base64_decoded_size(son_size_t nchar){
+	return (nchar / 4) * 3 + ((nchar % 4) * 3) / 4;
+}
+
+son_size_t son_local_base64_encode(char * dest, const void * src, son_size_t nbyte){
+	const u8 * data = src;
+	son_size_t k = 0;
+
+#if defined __AVX2__
+	//24 bytes in, 32 characters out (each lane loads 16 bytes and uses 12)
+	while( nbyte >= 28 ){
+		__m256i in = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)data)),
+				_mm_loadu_si128((const __m128i*)(data + 12)),
+				1);
+		__m256i indices;
+		__m256i t0, t1, t2, t3, result, less;
+		const __m256i shift_lut = _mm256_setr_epi8(
+				'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+				'/' - 63, 'A', 0, 0,
+				'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+				'/' - 63, 'A', 0, 0);
+
+		in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+				1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+				1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		indices = _mm256_or_si256(t1, t3);
+
+		result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+		result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices);
+
+		_mm256_storeu_si256((__m256i*)(dest + k), result);
+		data += 24;
+		nbyte -= 24;
+		k += 32;
+	}
+#endif
+
+#if defined __SSSE3__ || defined __AVX2__
+	//12 bytes in, 16 characters out (loads 16 bytes)
+	while( nbyte >= 16 ){
+		__m128i in = _mm_loadu_si128((const __m128i*)data);
+		_mm_storeu_si128((__m128i*)(dest + k), encode_ssse3_translate(encode_ssse3_reshuffle(in)));
+		data += 12;
+		nbyte -= 12;
+		k += 16;
+	}
+#elif defined __ARM_NEON && defined __aarch64__
+	//48 bytes in, 64 characters out
+	if( nbyte >= 48 ){
+		uint8x16x4_t lut;
+		lut.val[0] = vld1q_u8((const u8*)encode_table);
+		lut.val[1] = vld1q_u8((const u8*)encode_table + 16);
+		lut.val[2] = vld1q_u8((const u8*)encode_table + 32);
+		lut.val[3] = vld1q_u8((const u8*)encode_table + 48);
+		while( nbyte >= 48 ){
+			uint8x16x3_t in = vld3q_u8(data);
+			uint8x16x4_t out;
+			out.val[0] = vshrq_n_u8(in.val[0], 2);
+			out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), vdupq_n_u8(0x3f));
+			out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), vdupq_n_u8(0x3f));
+			out.val[3] = vandq_u8(in.val[2], vdupq_n_u8(0x3f));
+			out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+			out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+			out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+			out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+			vst4q_u8((u8*)dest + k, out);
+			data += 48;
+			nbyte -= 48;
+			k += 64;
+		}
+	}
+#endif
+
+	k += encode_scalar(dest + k, data, nbyte);
+	dest[k] = 0;
+	return k;
+}
+
+son_size_t encode_scalar(char * dest, const u8 * src, son_size_t nbyte){
+	son_size_t k = 0;
+	u32 value;
+
+	//encode three bytes at a time in to four characters
+	while( nbyte >= 3 ){
+		value = (src[0] << 16) | (src[1] << 8) | src[2];
+		dest[k] = encode_table[(value >> 18) & 0x3f];
+		dest[k+1] = encode_table[(value >> 12) & 0x3f];
+		dest[k+2] = encode_table[(value >> 6) & 0x3f];
+		dest[k+3] = encode_table[value & 0x3f];
+		src += 3;
+		nbyte -= 3;
+		k += 4;
+	}
+
+	//pad the last group without reading past the end of src
+	if( nbyte > 0 ){
+		value = src[0] << 16;
+		if( nbyte == 2 ){
+			value |= src[1] << 8;
+		}
+		dest[k] = encode_table[(value >> 18) & 0x3f];
+		dest[k+1] = encode_table[(value >> 12) & 0x3f];
+		dest[k+2] = nbyte == 2 ? encode_table[(value >> 6) & 0x3f] : '=';
+		dest[k+3] = '=';
+		k += 4;
+	}
+
+	return k;
+}
+
+#if defined __SSSE3__ || defined __AVX2__
+__m128i encode_ssse3_reshuffle(__m128i in){
+	__m128i t0, t1, t2, t3;
+	//put each group of three bytes in a 32-bit word as [b1 b0 b2 b1]
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	//move each six-bit field to the bottom of its own byte
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+__m128i encode_ssse3_translate(__m128i indices){
+	__m128i result, less;
+	const __m128i shift_lut = _mm_setr_epi8(
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+			'/' - 63, 'A', 0, 0);
+	//map each range of six-bit values to the offset that turns it in to a character
+	result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+#endif
+
+int son_local_base64_decode(void * dest, const char * src, son_size_t nchar){
+	u8 * data = dest;
+	son_size_t k = 0;
+	son_size_t i;
+	u32 value;
+	u8 six;
+	int count;
+
+	//padding is optional
+	while( (nchar > 0) && (src[nchar-1] == '=') ){
+		nchar--;
+	}
+
+	if( (nchar % 4) == 1 ){
+		return -1;
+	}
+
+	value = 0;
+	count = 0;
+	for(i=0; i < nchar; i++){
+		six = decode_table[(u8)src[i]];
+		if( six == BASE64_INVALID ){
+			return -1;
+		}
+		value = (value << 6) | six;
+		count++;
+		if( count == 4 ){
+			data[k] = value >> 16;
+			data[k+1] = value >> 8;
+			data[k+2] = value;
+			k += 3;
+			value = 0;
+			count = 0;
+		}
+	}
+
+	//a partial group holds one or two bytes
+	if( count == 2 ){
+		data[k++] = value >> 4;
+	} else if( count == 3 ){
+		data[k] = value >> 10;
+		data[k+1] = value >> 2;
+		k += 2;
+	}
+
+	return k;
+}
@@ -17,6 +17,18 @@ int son_edit_num(son_t * h, const char * key, s32 v){
 	return edit_raw_data(h, key, &v, sizeof(v), SON_NUMBER_S32);
 }
 
+int son_edit_num64(son_t * h, const char * key, s64 v){
+	return edit_raw_data(h, key, &v, sizeof(v), SON_NUMBER_S64);
+}
+
+int son_edit_unum64(son_t * h, const char * key, u64 v){
+	return edit_raw_data(h, key, &v, sizeof(v), SON_NUMBER_U64);
+}
+
+int son_edit_double(son_t * h, const char * key, double v){
+	return edit_raw_data(h, key, &v, sizeof(v), SON_DOUBLE);
+}
+
 int son_edit_str(son_t * h, const char * key, const char * v){
 	return edit_raw_data(h, key, v, strlen(v)+1, SON_STRING);
 }
@@ -26,7 +38,7 @@ int son_edit_data(son_t * h, const char * key, const void * data, son_size_t siz
 }
 
 int son_edit_bool(son_t * h, const char * key, int v){
-	size_t pos;
+	son_size_t pos;
 	son_store_t store;
 	son_value_t type;
 	int read_length;
@@ -49,10 +61,13 @@ int son_edit_bool(son_t * h, const char * key, int v){
 
 		son_local_store_set_type(&store, type);
 
-		pos = son_local_phy_lseek_current(h, -1*(s32)sizeof(store));
-		son_local_store_set_next(&store, pos+sizeof(son_store_t));
+		pos = son_local_phy_lseek_current(h, -1*(son_phy_off_t)son_local_store_size(h));
+		son_local_store_set_next(&store, pos+son_local_store_size(h));
 
 		ret = son_local_store_write(h, &store);
+		if( ret >= 0 ){
+			h->o_flags |= SON_LOCAL_FLAG_MODIFIED;
+		}
 
 	}
 
@@ -82,6 +97,9 @@ int edit_raw_data(son_t * h, const char * key, const void * data, son_size_t siz
 			}
 
 			ret =  son_phy_write(&(h->phy), data, size);
+			if( ret >= 0 ){
+				h->o_flags |= SON_LOCAL_FLAG_MODIFIED;
+			}
 
 		}
 	}
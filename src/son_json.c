@@ -0,0 +1,705 @@
+/*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
+
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+
+#include "son_local.h"
+
+#if defined __SSE2__
+#include <emmintrin.h>
+#elif defined __ARM_NEON && defined __aarch64__
+#include <arm_neon.h>
+#endif
+
+//array elements need a key in SON but JSON doesn't have one
+#define JSON_ARRAY_KEY "[]"
+#define JSON_NUMBER_MAX 64
+
+//reads the JSON text a buffer at a time from a file or a callback
+typedef struct {
+	son_phy_t * phy;
+	int (*callback)(void*, char*, int);
+	void * context;
+	u32 len;
+	u32 offset;
+	u8 is_eof;
+	char buffer[SON_JSON_BUFFER_SIZE];
+} json_reader_t;
+
+//tracks whether a string value can be stored as base64 decoded data
+typedef struct {
+	son_size_t len;
+	u8 pad;
+	u8 is_valid;
+} json_base64_t;
+
+static int json_fill(json_reader_t * r);
+static int json_peek(json_reader_t * r);
+static int json_getc(json_reader_t * r);
+static int json_skip_whitespace(json_reader_t * r);
+static int json_expect(json_reader_t * r, const char * literal);
+static u32 json_scan_string(const char * s, u32 n);
+static int json_read_escape(json_reader_t * r, char * utf8);
+static int json_read_hex(json_reader_t * r);
+static int json_read_key(json_reader_t * r, char * key);
+static int json_read_str(son_t * h, json_reader_t * r, const char * key);
+static int json_read_number(son_t * h, json_reader_t * r, const char * key);
+static void json_check_base64(json_base64_t * b, const char * s, u32 n);
+static int json_convert_base64(son_t * h, son_size_t start, son_size_t end);
+
+int son_from_json(son_t * h, const char * path, int (*callback)(void*, char*, int), void * context){
+	u32 is_array[SON_JSON_DEPTH_MAX/32+1];
+	u32 bit;
+	char key[SON_KEY_NAME_CAPACITY];
+	const char * k;
+	son_phy_t phy;
+	json_reader_t r;
+	int depth;
+	int is_first;
+	int c;
+	int ret;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	if( (h->stack_size == 0) || (h->stack_loc != 0) ){
+		//the JSON is imported as the root of a new document
+		h->err = SON_ERR_CANNOT_WRITE;
+		son_local_assign_checksum(h);
+		return -1;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.callback = callback;
+	r.context = context;
+
+	if( path != 0 ){
+		memset(&phy, 0, sizeof(phy));
+		if( son_phy_open(&phy, path, SON_O_RDONLY, 0) < 0 ){
+			h->err = SON_ERR_OPEN_IO;
+			son_local_assign_checksum(h);
+			return -1;
+		}
+		r.phy = &phy;
+	}
+
+	depth = 0;
+	is_first = 1;
+	ret = 0;
+
+	c = json_skip_whitespace(&r);
+	if( c == '{' ){
+		ret = son_open_object(h, "");
+	} else if( c == '[' ){
+		ret = son_open_array(h, "");
+	} else {
+		ret = -1;
+	}
+
+	if( ret >= 0 ){
+		json_getc(&r);
+		is_array[0] = (c == '[');
+		depth = 1;
+	}
+
+	while( (depth > 0) && (ret >= 0) ){
+
+		c = json_skip_whitespace(&r);
+		bit = is_array[(depth-1)/32] & (1U<<((depth-1)%32));
+
+		if( (c == ']') || (c == '}') ){
+			//a closing bracket must match and can't follow a comma
+			if( ((c == ']') != (bit != 0)) || (is_first < 0) ){
+				ret = -1;
+			} else {
+				json_getc(&r);
+				ret = (c == ']') ? son_close_array(h) : son_close_object(h);
+				depth--;
+				is_first = 0;
+			}
+			continue;
+		}
+
+		if( is_first == 0 ){
+			//members are separated by commas
+			if( c != ',' ){
+				ret = -1;
+			} else {
+				json_getc(&r);
+				is_first = -1;
+			}
+			continue;
+		}
+
+		if( bit ){
+			k = JSON_ARRAY_KEY;
+		} else {
+			if( (c != '"') || (json_read_key(&r, key) < 0) ){
+				ret = -1;
+				continue;
+			}
+			if( json_skip_whitespace(&r) != ':' ){
+				ret = -1;
+				continue;
+			}
+			json_getc(&r);
+			c = json_skip_whitespace(&r);
+			k = key;
+			if( k[0] == 0 ){
+				//empty keys are only allowed for the root
+				k = JSON_ARRAY_KEY;
+			}
+		}
+
+		is_first = 0;
+
+		switch(c){
+		case '{':
+		case '[':
+			if( depth == SON_JSON_DEPTH_MAX ){
+				h->err = SON_ERR_STACK_OVERFLOW;
+				son_local_assign_checksum(h);
+				ret = -1;
+				break;
+			}
+			json_getc(&r);
+			ret = (c == '[') ? son_open_array(h, k) : son_open_object(h, k);
+			if( c == '[' ){
+				is_array[depth/32] |= (1U<<(depth%32));
+			} else {
+				is_array[depth/32] &= ~(1U<<(depth%32));
+			}
+			depth++;
+			is_first = 1;
+			break;
+		case '"':
+			ret = json_read_str(h, &r, k);
+			break;
+		case 't':
+			ret = json_expect(&r, "true") < 0 ? -1 : son_write_true(h, k);
+			break;
+		case 'f':
+			ret = json_expect(&r, "false") < 0 ? -1 : son_write_false(h, k);
+			break;
+		case 'n':
+			ret = json_expect(&r, "null") < 0 ? -1 : son_write_null(h, k);
+			break;
+		default:
+			ret = json_read_number(h, &r, k);
+			break;
+		}
+	}
+
+	if( (ret >= 0) && (json_skip_whitespace(&r) != -1) ){
+		//only whitespace can follow the root
+		ret = -1;
+	}
+
+	if( path != 0 ){
+		son_phy_close(&phy);
+	}
+
+	if( (ret < 0) && (h->err == SON_ERR_NONE) ){
+		h->err = SON_ERR_JSON_SYNTAX;
+		son_local_assign_checksum(h);
+	}
+
+	return ret < 0 ? -1 : 0;
+}
+
+int json_fill(json_reader_t * r){
+	int ret;
+
+	if( r->offset < r->len ){
+		return r->len - r->offset;
+	}
+
+	if( r->is_eof ){
+		return 0;
+	}
+
+	r->offset = 0;
+	if( r->phy ){
+		ret = son_phy_read(r->phy, r->buffer, SON_JSON_BUFFER_SIZE);
+	} else if( r->callback ){
+		ret = r->callback(r->context, r->buffer, SON_JSON_BUFFER_SIZE);
+	} else {
+		ret = 0;
+	}
+
+	if( ret <= 0 ){
+		r->len = 0;
+		r->is_eof = 1;
+		return 0;
+	}
+
+	r->len = ret;
+	return ret;
+}
+
+int json_peek(json_reader_t * r){
+	if( json_fill(r) == 0 ){
+		return -1;
+	}
+	return (u8)r->buffer[r->offset];
+}
+
+int json_getc(json_reader_t * r){
+	if( json_fill(r) == 0 ){
+		return -1;
+	}
+	return (u8)r->buffer[r->offset++];
+}
+
+int json_skip_whitespace(json_reader_t * r){
+	char c;
+	while( json_fill(r) > 0 ){
+		while( r->offset < r->len ){
+			c = r->buffer[r->offset];
+			if( (c != ' ') && (c != '\n') && (c != '\r') && (c != '\t') ){
+				return (u8)c;
+			}
+			r->offset++;
+		}
+	}
+	return -1;
+}
+
+int json_expect(json_reader_t * r, const char * literal){
+	while( *literal != 0 ){
+		if( json_getc(r) != *literal ){
+			return -1;
+		}
+		literal++;
+	}
+	return 0;
+}
+
+u32 json_scan_string(const char * s, u32 n){
+	u32 i = 0;
+
+	//find the next quote, backslash or control character
+#if defined __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1f);
+	while( n - i >= 16 ){
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i m = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+				_mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+		int mask = _mm_movemask_epi8(m);
+		if( mask ){
+			return i + __builtin_ctz(mask);
+		}
+		i += 16;
+	}
+#elif defined __ARM_NEON && defined __aarch64__
+	while( n - i >= 16 ){
+		uint8x16_t v = vld1q_u8((const u8*)s + i);
+		uint8x16_t m = vorrq_u8(
+				vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+				vcltq_u8(v, vdupq_n_u8(0x20)));
+		if( vmaxvq_u8(m) ){
+			break;
+		}
+		i += 16;
+	}
+#endif
+
+	while( i < n ){
+		u8 c = s[i];
+		if( (c == '"') || (c == '\\') || (c < 0x20) ){
+			break;
+		}
+		i++;
+	}
+	return i;
+}
+
+int json_read_hex(json_reader_t * r){
+	int value = 0;
+	int i;
+	int c;
+	for(i=0; i < 4; i++){
+		c = json_getc(r);
+		if( (c >= '0') && (c <= '9') ){
+			c = c - '0';
+		} else if( (c >= 'a') && (c <= 'f') ){
+			c = c - 'a' + 10;
+		} else if( (c >= 'A') && (c <= 'F') ){
+			c = c - 'A' + 10;
+		} else {
+			return -1;
+		}
+		value = (value << 4) | c;
+	}
+	return value;
+}
+
+int json_read_escape(json_reader_t * r, char * utf8){
+	int c;
+	int low;
+	u32 code;
+
+	//the backslash has already been read
+	c = json_getc(r);
+	switch(c){
+	case '"': utf8[0] = '"'; return 1;
+	case '\\': utf8[0] = '\\'; return 1;
+	case '/': utf8[0] = '/'; return 1;
+	case 'b': utf8[0] = '\b'; return 1;
+	case 'f': utf8[0] = '\f'; return 1;
+	case 'n': utf8[0] = '\n'; return 1;
+	case 'r': utf8[0] = '\r'; return 1;
+	case 't': utf8[0] = '\t'; return 1;
+	case 'u': break;
+	default: return -1;
+	}
+
+	if( (c = json_read_hex(r)) < 0 ){
+		return -1;
+	}
+	code = c;
+
+	if( (code >= 0xD800) && (code <= 0xDBFF) ){
+		//a surrogate pair encodes one code point
+		if( (json_getc(r) != '\\') || (json_getc(r) != 'u') ){
+			return -1;
+		}
+		low = json_read_hex(r);
+		if( (low < 0xDC00) || (low > 0xDFFF) ){
+			return -1;
+		}
+		code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+	}
+
+	if( code < 0x80 ){
+		utf8[0] = code;
+		return 1;
+	} else if( code < 0x800 ){
+		utf8[0] = 0xC0 | (code >> 6);
+		utf8[1] = 0x80 | (code & 0x3F);
+		return 2;
+	} else if( code < 0x10000 ){
+		utf8[0] = 0xE0 | (code >> 12);
+		utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+		utf8[2] = 0x80 | (code & 0x3F);
+		return 3;
+	}
+	utf8[0] = 0xF0 | (code >> 18);
+	utf8[1] = 0x80 | ((code >> 12) & 0x3F);
+	utf8[2] = 0x80 | ((code >> 6) & 0x3F);
+	utf8[3] = 0x80 | (code & 0x3F);
+	return 4;
+}
+
+int json_read_key(json_reader_t * r, char * key){
+	char utf8[4];
+	u32 len = 0;
+	u32 n;
+	int c;
+
+	//skip the opening quote
+	json_getc(r);
+
+	//keys longer than SON_KEY_NAME_SIZE are truncated like son_local_store_insert_key()
+	while( json_fill(r) > 0 ){
+		n = json_scan_string(r->buffer + r->offset, r->len - r->offset);
+		if( len + n > SON_KEY_NAME_SIZE ){
+			memcpy(key + len, r->buffer + r->offset, SON_KEY_NAME_SIZE - len);
+			len = SON_KEY_NAME_SIZE;
+		} else {
+			memcpy(key + len, r->buffer + r->offset, n);
+			len += n;
+		}
+		r->offset += n;
+
+		if( r->offset == r->len ){
+			continue;
+		}
+
+		c = json_getc(r);
+		if( c == '"' ){
+			key[len] = 0;
+			return 0;
+		} else if( c == '\\' ){
+			if( (c = json_read_escape(r, utf8)) < 0 ){
+				return -1;
+			}
+			if( len + c <= SON_KEY_NAME_SIZE ){
+				memcpy(key + len, utf8, c);
+				len += c;
+			}
+		} else {
+			//control characters must be escaped
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+int json_read_str(son_t * h, json_reader_t * r, const char * key){
+	char chunk[SON_JSON_CHUNK_SIZE];
+	char utf8[4];
+	json_base64_t base64;
+	son_size_t start;
+	u32 len;
+	u32 n;
+	u32 page;
+	int c;
+	int ret;
+
+	//skip the opening quote
+	json_getc(r);
+
+	//the string is copied to the document as it is read
+	if( son_local_write_open_type(h, key, SON_STRING) < 0 ){
+		return -1;
+	}
+
+	memset(&base64, 0, sizeof(base64));
+	base64.is_valid = (h->o_flags & SON_FLAG_JSON_DATA) != 0;
+	start = h->stack[h->stack_loc-1].pos + son_local_store_size(h);
+	len = 0;
+	ret = -1;
+
+	while( json_fill(r) > 0 ){
+		n = json_scan_string(r->buffer + r->offset, r->len - r->offset);
+		if( base64.is_valid ){
+			json_check_base64(&base64, r->buffer + r->offset, n);
+		}
+
+		//unescaped runs are copied straight from the input buffer
+		while( n > 0 ){
+			if( len == SON_JSON_CHUNK_SIZE ){
+				if( son_write_open_data(h, chunk, len) < 0 ){ return -1; }
+				len = 0;
+			}
+			page = SON_JSON_CHUNK_SIZE - len;
+			if( page > n ){ page = n; }
+			memcpy(chunk + len, r->buffer + r->offset, page);
+			r->offset += page;
+			len += page;
+			n -= page;
+		}
+
+		if( r->offset == r->len ){
+			continue;
+		}
+
+		c = json_getc(r);
+		if( c == '"' ){
+			ret = 0;
+			break;
+		} else if( c == '\\' ){
+			//escaped strings are never base64
+			base64.is_valid = 0;
+			if( (c = json_read_escape(r, utf8)) < 0 ){
+				return -1;
+			}
+			if( len + c > SON_JSON_CHUNK_SIZE ){
+				if( son_write_open_data(h, chunk, len) < 0 ){ return -1; }
+				len = 0;
+			}
+			memcpy(chunk + len, utf8, c);
+			len += c;
+		} else {
+			//control characters must be escaped
+			return -1;
+		}
+	}
+
+	if( ret < 0 ){
+		return -1;
+	}
+
+	if( (len > 0) && (son_write_open_data(h, chunk, len) < 0) ){
+		return -1;
+	}
+
+	//padding is required -- plain words like "John" or "true" are valid base64 too
+	if( base64.is_valid && (base64.pad > 0) && ((base64.len % 4) == 0) ){
+		if( json_convert_base64(h, start, start + base64.len) < 0 ){
+			return -1;
+		}
+	} else {
+		//add the zero terminator
+		if( son_write_open_data(h, "", 1) < 0 ){
+			return -1;
+		}
+	}
+
+	return son_close_data(h);
+}
+
+void json_check_base64(json_base64_t * b, const char * s, u32 n){
+	u32 i;
+	char c;
+	for(i=0; i < n; i++){
+		c = s[i];
+		if( c == '=' ){
+			//padding can only be at the end
+			if( ++b->pad > 2 ){
+				b->is_valid = 0;
+				return;
+			}
+		} else if( b->pad ||
+				!(((c >= 'A') && (c <= 'Z')) ||
+						((c >= 'a') && (c <= 'z')) ||
+						((c >= '0') && (c <= '9')) ||
+						(c == '+') || (c == '/')) ){
+			b->is_valid = 0;
+			return;
+		}
+	}
+	b->len += n;
+}
+
+int json_convert_base64(son_t * h, son_size_t start, son_size_t end){
+	char text[SON_JSON_CHUNK_SIZE/3*4];
+	char data[SON_JSON_CHUNK_SIZE];
+	son_size_t read_pos;
+	son_size_t write_pos;
+	son_store_t store;
+	son_size_t pos;
+	u32 page;
+	int ret;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	//decode in place -- the data is always shorter than the text
+	read_pos = start;
+	write_pos = start;
+	ret = 0;
+	while( (read_pos < end) && (ret == 0) ){
+		page = end - read_pos > sizeof(text) ? sizeof(text) : end - read_pos;
+		if( (son_local_phy_lseek_set(h, read_pos) < 0) ||
+				(son_phy_read(&(h->phy), text, page) != (int)page) ){
+			h->err = SON_ERR_READ_IO;
+			ret = -1;
+		} else if( (ret = son_local_base64_decode(data, text, page)) >= 0 ){
+			read_pos += page;
+			if( (son_local_phy_lseek_set(h, write_pos) < 0) ||
+					(son_phy_write(&(h->phy), data, ret) != ret) ){
+				h->err = SON_ERR_WRITE_IO;
+				ret = -1;
+			} else {
+				write_pos += ret;
+				ret = 0;
+			}
+		}
+	}
+
+	//clear the rest of the text so nothing is left past the value (or the end of the document)
+	memset(text, 0, sizeof(text));
+	for(pos = write_pos; (pos < end) && (ret == 0); pos += page){
+		page = end - pos > sizeof(text) ? sizeof(text) : end - pos;
+		if( (son_local_phy_lseek_set(h, pos) < 0) ||
+				(son_phy_write(&(h->phy), text, page) != (int)page) ){
+			h->err = SON_ERR_WRITE_IO;
+			ret = -1;
+		}
+	}
+
+	//change the type of the open value to data
+	if( ret == 0 ){
+		pos = h->stack[h->stack_loc-1].pos;
+		if( (son_local_phy_lseek_set(h, pos) < 0) || (son_local_store_read(h, &store) < 0) ){
+			ret = -1;
+		} else {
+			son_local_store_set_type(&store, SON_DATA);
+			if( (son_local_phy_lseek_set(h, pos) < 0) ||
+					(son_local_store_write(h, &store) < 0) ||
+					(son_local_phy_lseek_set(h, write_pos) < 0) ){
+				ret = -1;
+			}
+		}
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+int json_read_number(son_t * h, json_reader_t * r, const char * key){
+	char number[JSON_NUMBER_MAX+1];
+	char * end;
+	u32 len;
+	u32 digits;
+	int is_float;
+	int is_exponent;
+	int c;
+	double d;
+	double magnitude;
+	s64 n;
+	u64 u;
+
+	len = 0;
+	digits = 0;
+	is_float = 0;
+	is_exponent = 0;
+	while( ((c = json_peek(r)) >= 0) &&
+			(((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.') || (c == 'e') || (c == 'E')) ){
+		if( len == JSON_NUMBER_MAX ){
+			return -1;
+		}
+		if( (c == '.') || (c == 'e') || (c == 'E') ){
+			is_float = 1;
+			if( c != '.' ){
+				is_exponent = 1;
+			}
+		} else if( (c >= '0') && (c <= '9') && (is_exponent == 0) ){
+			//count the significant digits (leading zeros don't count)
+			if( (c != '0') || (digits > 0) ){
+				digits++;
+			}
+		}
+		number[len++] = c;
+		json_getc(r);
+	}
+	number[len] = 0;
+
+	if( (len == 0) || ((number[0] != '-') && ((number[0] < '0') || (number[0] > '9'))) ){
+		return -1;
+	}
+
+	if( is_float == 0 ){
+		errno = 0;
+		if( number[0] == '-' ){
+			n = strtoll(number, &end, 10);
+			if( (*end == 0) && (errno == 0) ){
+				if( n >= INT32_MIN ){
+					return son_write_num(h, key, n);
+				}
+				return son_write_num64(h, key, n);
+			}
+		} else {
+			u = strtoull(number, &end, 10);
+			if( (*end == 0) && (errno == 0) ){
+				if( u <= INT32_MAX ){
+					return son_write_num(h, key, u);
+				} else if( u <= UINT32_MAX ){
+					return son_write_unum(h, key, u);
+				}
+				return son_write_unum64(h, key, u);
+			}
+		}
+		if( *end != 0 ){
+			return -1;
+		}
+		//integers that don't fit in 64-bits are saved as doubles
+	}
+
+	d = strtod(number, &end);
+	if( *end != 0 ){
+		return -1;
+	}
+
+	//use a float if it holds the value as precisely as it was written
+	magnitude = d < 0 ? -d : d;
+	if( (digits <= FLT_DIG) && ((magnitude == 0) || ((magnitude >= FLT_MIN) && (magnitude <= FLT_MAX))) ){
+		return son_write_float(h, key, d);
+	}
+	return son_write_double(h, key, d);
+}
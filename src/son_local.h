@@ -22,16 +22,66 @@
 
 #define SON_MARKER_MASK (0x0F)
 
+//the upper bits of o_flags mark stores related to indexes
+#define SON_STORE_FLAG_INDEXED (0x10) //the object or array ends with an index
+#define SON_STORE_FLAG_INDEX (0x20) //the store is an index (hidden from readers)
+
+#define SON_INDEX_KEY "$index"
+
+/*
+ * An index is stored as the last member of the object or array it belongs to:
+ *
+ * son_store_t (SON_STORE_FLAG_INDEX) | entries | son_index_trailer_t
+ *
+ * The trailer is at the end of the parent so it can be found using
+ * the parent's next value.
+ *
+ * Arrays use a table of u32 offsets (from the parent store) for elements
+ * 0, stride, 2*stride, ... The number of entries is (count + stride - 1) / stride.
+ *
+ */
+typedef struct MCU_PACK {
+	u32 count /*! number of slots (key index) or number of elements (array table) */;
+	u32 stride /*! zero for key indexes (hash table of son_index_slot_t) otherwise elements between array table entries */;
+} son_index_trailer_t;
+
+typedef struct MCU_PACK {
+	u32 hash /*! hash of the member key */;
+	u32 offset /*! offset of the member store from the parent store (zero if the slot is empty) */;
+} son_index_slot_t;
+
+//the upper bit of the header version marks documents that use the large store format
+#define SON_HDR_FLAG_LARGE (0x8000)
+//the next bit marks documents that are followed by a CRC32C of everything before it (see SON_FLAG_CRC)
+#define SON_HDR_FLAG_CRC (0x4000)
+
+//handle options that are set by the document header
+#define SON_LOCAL_FLAG_HEADER (SON_FLAG_LARGE | SON_FLAG_CRC)
+//the document CRC has been checked so stores are read without checking them
+#define SON_LOCAL_FLAG_VERIFIED (1<<30)
+//the document was edited so the CRC needs to be written when the handle is closed
+#define SON_LOCAL_FLAG_MODIFIED (1<<31)
+
 typedef struct MCU_PACK {
 	u16 version;
 	u16 resd;
 } son_hdr_t;
 
+//packed typed arrays start with this header followed by the elements
+typedef struct MCU_PACK {
+	u8 type; //son_array_type_t
+	u8 size; //bytes per element
+	u16 resd;
+} son_typed_array_hdr_t;
+
 typedef union {
 	float * f;
 	int * n;
 	u32 * n_u32;
 	s32 * n_s32;
+	u64 * n_u64;
+	s64 * n_s64;
+	double * d;
 	char * cdata;
 	void * data;
 } son_type_t;
@@ -51,15 +101,42 @@ typedef struct MCU_PACK {
 	son_pos_t pos;
 	son_key_t key;
 	u32 checksum;
+	u32 page_high; //upper bits of the next position (only stored in large documents)
 } son_store_t;
 
+//compact documents don't store page_high so they are limited to 16MB
+#define SON_STORE_SIZE_COMPACT (sizeof(son_store_t) - sizeof(u32))
+
 #define TRUE 1
 #define FALSE 0
 
 #define SON_BUFFER_SIZE 32
 
+//values up to this size are written together with their store
+#define SON_WRITE_GATHER_SIZE 64
+
+//files are read in chunks of this size to calculate the document CRC
+#if defined __StratifyOS__
+#define SON_CRC_BUFFER_SIZE 256
+#else
+#define SON_CRC_BUFFER_SIZE 4096
+#endif
+
+//aligned so that 64-bit values can be accessed in place
+typedef union {
+	char cdata[SON_BUFFER_SIZE];
+	u64 n_u64;
+	double d;
+} son_buffer_t;
+
+#if SON_HANDLE_CHECKSUM
 void son_local_assign_checksum(son_t * h);
 int son_local_verify_checksum(son_t * h);
+#else
+//the handle isn't checked so the calls compile to nothing
+#define son_local_assign_checksum(h)
+#define son_local_verify_checksum(h) (0)
+#endif
 
 static u8 son_local_store_type(const son_store_t * son) MCU_UNUSED;
 u8 son_local_store_type(const son_store_t * son){
@@ -71,28 +148,67 @@ void son_local_store_set_type(son_store_t * son, u8 type){
 	son->o_flags = (type & SON_MARKER_MASK);
 }
 
-static u32 son_local_store_next(const son_store_t * son) MCU_UNUSED;
-u32 son_local_store_next(const son_store_t * son){
-	return son->pos.page*65536 + son->pos.page_offset;
+static u8 son_local_store_flags(const son_store_t * son) MCU_UNUSED;
+u8 son_local_store_flags(const son_store_t * son){
+	return son->o_flags & ~SON_MARKER_MASK;
+}
+
+static son_size_t son_local_store_next(const son_store_t * son) MCU_UNUSED;
+son_size_t son_local_store_next(const son_store_t * son){
+	return ((son_size_t)son->page_high << 24) + son->pos.page*65536 + son->pos.page_offset;
 }
 
-static void son_local_store_set_next(son_store_t * son, u32 offset) MCU_UNUSED;
-void son_local_store_set_next(son_store_t * son, u32 offset){
-	son->pos.page = offset >> 16;
+static void son_local_store_set_next(son_store_t * son, son_size_t offset) MCU_UNUSED;
+void son_local_store_set_next(son_store_t * son, son_size_t offset){
+	son->pos.page = (offset >> 16) & 0xFF;
 	son->pos.page_offset = offset & 0xFFFF;
+	son->page_high = offset >> 24;
+}
+
+static u8 son_local_array_type_size(u8 type) MCU_UNUSED;
+u8 son_local_array_type_size(u8 type){
+	switch(type){
+	case SON_ARRAY_U8: return sizeof(u8);
+	case SON_ARRAY_S16: return sizeof(s16);
+	case SON_ARRAY_U32: return sizeof(u32);
+	case SON_ARRAY_S32: return sizeof(s32);
+	case SON_ARRAY_FLOAT: return sizeof(float);
+	case SON_ARRAY_DOUBLE: return sizeof(double);
+	}
+	return 0;
+}
+
+static son_size_t son_local_store_size(const son_t * h) MCU_UNUSED;
+son_size_t son_local_store_size(const son_t * h){
+	return (h->o_flags & SON_FLAG_LARGE) ? sizeof(son_store_t) : SON_STORE_SIZE_COMPACT;
 }
 
 void son_local_store_insert_key(son_store_t * store, const char * key);
 u32 son_local_store_calc_checksum(son_store_t * store);
+u32 son_local_key_hash(const u8 * key);
 
 int son_local_store_read(son_t * h, son_store_t * store);
 int son_local_store_write(son_t * h, son_store_t * store);
+int son_local_store_write_value(son_t * h, son_store_t * store, const void * v, son_size_t size);
 int son_local_store_seek(son_t * h, const char * access, son_store_t * store, son_size_t * data_size);
+int son_local_store_seek_path(son_t * h, const son_path_t * path, son_store_t * store, son_size_t * data_size);
+int son_local_path_compile(son_t * h, son_path_t * path, const char * access);
 
-int son_local_phy_lseek_current(son_t * h, s32 offset);
-int son_local_phy_lseek_set(son_t * h, s32 offset);
+son_phy_off_t son_local_phy_lseek_current(son_t * h, son_phy_off_t offset);
+son_phy_off_t son_local_phy_lseek_set(son_t * h, son_phy_off_t offset);
 
 int son_local_read_raw_data(son_t * h, const char * access, void * data, son_size_t size, son_store_t * son);
+int son_local_read_raw_data_path(son_t * h, const son_path_t * path, void * data, son_size_t size, son_store_t * son);
+int son_local_write_open_type(son_t * h, const char * key, u8 type);
+int son_local_doc_release(son_doc_t * doc);
+int son_local_crc_write(son_t * h);
+
+son_size_t son_local_base64_encoded_size(son_size_t nbyte);
+son_size_t son_local_base64_decoded_size(son_size_t nchar);
+son_size_t son_local_base64_encode(char * dest, const void * src, son_size_t nbyte);
+int son_local_base64_decode(void * dest, const char * src, son_size_t nchar);
+
+u32 son_local_crc32c(u32 crc, const void * data, son_size_t nbyte);
 
 
 #if !defined __StratifyOS__
@@ -18,11 +18,12 @@
 
 #if defined __link
 #define error_number link_errno
+#define ERROR_AGAIN 11
 #else
 #define error_number errno
+#define ERROR_AGAIN EAGAIN
 #endif
 
-#define ERROR_AGAIN 11
 #define COUNT_MULT 50
 
 void cortexm_assign_zero_sum32(void * data, int count){
@@ -58,17 +59,35 @@ typedef struct MCU_PACK {
 
 typedef int (*son_transfer_t)(son_phy_t * phy, int, void*, size_t);
 
+//son_send_messages() sends this many messages (header and body) in each gather write
+#define SON_MESSAGE_BATCH (SON_PHY_IOV_MAX/2)
+
+enum {
+	DECODER_STATE_START,
+	DECODER_STATE_HEADER,
+	DECODER_STATE_DATA,
+	DECODER_STATE_DISCARD
+};
+
 static int son_message_transfer_data(son_t * h, int fd, void *  data, int nbytes, int timeout, son_transfer_t transfer);
 static int son_message_recv_start(son_t * h, int fd, int timeout);
+static int son_message_transfer_vector(son_t * h, int fd, son_phy_iovec_t * iov, int count, int timeout);
+static int son_message_header(son_t * h, son_message_t * msg);
 static int son_is_message(son_t * h);
+static int son_message_wait(son_t * h, int fd, int is_write, int is_eof, int * count, int timeout);
+static int son_message_buffer_fill(son_t * h, son_message_buffer_t * rx, int fd, int timeout);
+static int son_message_buffer_find_start(son_message_buffer_t * rx);
+static int son_message_buffer_take(son_t * h, son_message_buffer_t * rx, int fd, void * data, int nbytes, int timeout);
 
 int son_get_message_size(son_t * h){
-	son_store_t * root;
-	u32 next;
+	son_store_t root;
+	son_size_t next;
 	int ret;
 	if( son_is_message(h) < 0 ){ return -1; }
-	root = (son_store_t *)(h->phy.message + sizeof(son_hdr_t));
-	next = son_local_store_next(root);
+	//copy the root store because compact documents don't have all the members
+	root.page_high = 0;
+	memcpy(&root, h->phy.message + sizeof(son_hdr_t), son_local_store_size(h));
+	next = son_local_store_next(&root);
 	if( next ){
 		ret = next + sizeof(son_hdr_t);
 	} else {
@@ -81,32 +100,75 @@ int son_get_message_size(son_t * h){
 
 int son_send_message(son_t * h, int fd, int timeout){
 	son_message_t msg;
+	son_phy_iovec_t iov[2];
 	int nbytes;
 
-	if( son_is_message(h) < 0 ){ return -1; }
-
-	nbytes = son_get_message_size(h);
+	nbytes = son_message_header(h, &msg);
 	if( nbytes <  0 ){ return -1; }
 
 	if( nbytes > 0 ) {
+		//the header and the message go out in one write
+		iov[0].buffer = &msg;
+		iov[0].nbyte = sizeof(msg);
+		iov[1].buffer = h->phy.message;
+		iov[1].nbyte = msg.size;
+		if( son_message_transfer_vector(h, fd, iov, 2, timeout) < 0 ){
+			//h->err is set by son_message_transfer_vector()
+			nbytes = -1;
+		}
+	}
+	son_local_assign_checksum(h);
 
-		nbytes = nbytes < h->phy.message_size ? nbytes : h->phy.message_size;
-		msg.start = SON_MESSAGE_START;
-		msg.size = nbytes;
-		cortexm_assign_zero_sum32(&msg, CORTEXM_ZERO_SUM32_COUNT(son_message_t));
+	return nbytes;
+}
 
-		if( son_message_transfer_data(h, fd, &msg, sizeof(msg), timeout, (son_transfer_t)son_phy_write_fileno) < 0 ){
-			//h->err is set by son_message_transfer_data()
-			nbytes = -1;
-		} else {
-			if( son_message_transfer_data(h, fd, h->phy.message, msg.size, timeout, (son_transfer_t)son_phy_write_fileno) < 0 ){
-				//h->err is set by son_message_transfer_data()
-				nbytes = -1;
+int son_send_messages(son_t * h, int count, int fd, int timeout){
+	son_message_t msg[SON_MESSAGE_BATCH];
+	son_phy_iovec_t iov[SON_MESSAGE_BATCH*2];
+	int total = 0;
+	int nbytes;
+	int i;
+	int j;
+	int n;
+
+	for(i=0; i < count; i += SON_MESSAGE_BATCH){
+		n = 0;
+		for(j=i; (j < count) && (j < i + SON_MESSAGE_BATCH); j++){
+			nbytes = son_message_header(h + j, msg + (j-i));
+			if( nbytes < 0 ){ return -1; }
+			if( nbytes > 0 ){
+				iov[n].buffer = msg + (j-i);
+				iov[n].nbyte = sizeof(son_message_t);
+				iov[n+1].buffer = h[j].phy.message;
+				iov[n+1].nbyte = nbytes;
+				n += 2;
+				total += nbytes;
 			}
+			son_local_assign_checksum(h + j);
 		}
+
+		//errors are reported using the first handle of the batch
+		if( son_local_verify_checksum(h + i) < 0 ){ return -1; }
+		nbytes = son_message_transfer_vector(h + i, fd, iov, n, timeout);
+		son_local_assign_checksum(h + i);
+		if( nbytes < 0 ){ return -1; }
 	}
-	son_local_assign_checksum(h);
 
+	return total;
+}
+
+int son_message_header(son_t * h, son_message_t * msg){
+	int nbytes;
+
+	if( son_is_message(h) < 0 ){ return -1; }
+
+	nbytes = son_get_message_size(h);
+	if( nbytes <  0 ){ return -1; }
+
+	nbytes = nbytes < h->phy.message_size ? nbytes : h->phy.message_size;
+	msg->start = SON_MESSAGE_START;
+	msg->size = nbytes;
+	cortexm_assign_zero_sum32(msg, CORTEXM_ZERO_SUM32_COUNT(son_message_t));
 	return nbytes;
 }
 
@@ -122,6 +184,8 @@ int son_recv_message(son_t * h, int fd, int timeout){
 		if( son_message_transfer_data(h, fd, &msg.size, sizeof(msg)-sizeof(u32), timeout, (son_transfer_t)son_phy_read_fileno) >= 0 ){
 			if( cortexm_verify_zero_sum32(&msg, CORTEXM_ZERO_SUM32_COUNT(son_message_t)) ){ //see if msg.checksum is valid
 				memset(h->phy.message, 0, h->phy.message_size);
+				//the new contents haven't been verified (see son_verify())
+				h->o_flags &= ~SON_LOCAL_FLAG_VERIFIED;
 				//now receive the actual data
 				s = msg.size < h->phy.message_size ? msg.size : h->phy.message_size;
 
@@ -139,33 +203,336 @@ int son_recv_message(son_t * h, int fd, int timeout){
 	return ret;
 }
 
+int son_init_message_buffer(son_message_buffer_t * rx, void * buffer, u32 size){
+	if( (buffer == 0) || (size < 16) ){
+		return -1;
+	}
+	rx->buffer = buffer;
+	rx->size = size;
+	rx->head = 0;
+	rx->len = 0;
+	rx->fd = -1;
+	rx->read_count = 0;
+	return 0;
+}
+
+int son_recv_message_buffered(son_t * h, int fd, int timeout, son_message_buffer_t * rx){
+	son_message_t msg;
+	int ret = -1;
+	int s;
+
+	if( son_is_message(h) < 0 ){ return -1; }
+
+	//leftover bytes belong to the descriptor they were read from
+	if( rx->fd != fd ){
+		rx->fd = fd;
+		rx->head = 0;
+		rx->len = 0;
+	}
+
+	//like son_message_recv_start(), each read waits for at most one period for the start
+	while( son_message_buffer_find_start(rx) == 0 ){
+		if( son_message_buffer_fill(h, rx, fd, 0) < 0 ){
+			son_local_assign_checksum(h);
+			return -1;
+		}
+	}
+
+	msg.start = SON_MESSAGE_START;
+	if( son_message_buffer_take(h, rx, fd, &msg.size, sizeof(msg)-sizeof(u32), timeout) >= 0 ){
+		if( cortexm_verify_zero_sum32(&msg, CORTEXM_ZERO_SUM32_COUNT(son_message_t)) ){ //see if msg.checksum is valid
+			memset(h->phy.message, 0, h->phy.message_size);
+			h->o_flags &= ~SON_LOCAL_FLAG_VERIFIED;
+			s = msg.size < h->phy.message_size ? msg.size : h->phy.message_size;
+
+			if( son_message_buffer_take(h, rx, fd, h->phy.message, s, timeout) >= 0 ){
+				ret = s;
+			}
+		}
+	}
+	son_local_assign_checksum(h);
+
+	return ret;
+}
+
+int son_init_message_decoder(son_message_decoder_t * decoder, void * message, int nbyte, son_message_decoder_callback_t callback, void * context){
+	if( (message == 0) || (nbyte <= 0) || (callback == 0) ){
+		return -1;
+	}
+	decoder->message = message;
+	decoder->size = nbyte;
+	decoder->callback = callback;
+	decoder->context = context;
+	decoder->len = 0;
+	decoder->count = 0;
+	decoder->state = DECODER_STATE_START;
+	decoder->message_count = 0;
+	decoder->error_count = 0;
+	return 0;
+}
+
+int son_feed_message_decoder(son_message_decoder_t * decoder, const void * data, int nbyte){
+	const u8 * p = data;
+	const u8 * end = p + nbyte;
+	u32 s;
+	u32 n;
+	int completed = 0;
+
+	while( p < end ){
+		switch( decoder->state ){
+		case DECODER_STATE_START:
+			//same as son_message_recv_start() but the first byte is found with memchr()
+			if( decoder->count == 0 ){
+				p = memchr(p, SON_MESSAGE_START & 0xff, end - p);
+				if( p == 0 ){
+					return completed;
+				}
+				p++;
+				decoder->count = 1;
+			} else if( *p == ((SON_MESSAGE_START >> (decoder->count*8)) & 0xff) ){
+				p++;
+				decoder->count++;
+			} else {
+				decoder->count = (*p == (SON_MESSAGE_START & 0xff));
+				p++;
+			}
+			if( decoder->count == sizeof(u32) ){
+				decoder->header[0] = SON_MESSAGE_START;
+				decoder->count = 0;
+				decoder->state = DECODER_STATE_HEADER;
+			}
+			break;
+
+		case DECODER_STATE_HEADER:
+			n = sizeof(son_message_t) - sizeof(u32) - decoder->count;
+			if( n > end - p ){
+				n = end - p;
+			}
+			memcpy((u8*)&(decoder->header[1]) + decoder->count, p, n);
+			p += n;
+			decoder->count += n;
+			if( decoder->count == sizeof(son_message_t) - sizeof(u32) ){
+				decoder->count = 0;
+				if( cortexm_verify_zero_sum32(decoder->header, CORTEXM_ZERO_SUM32_COUNT(son_message_t)) ){
+					decoder->len = decoder->header[1];
+					memset(decoder->message, 0, decoder->size);
+					decoder->state = DECODER_STATE_DATA;
+				} else {
+					decoder->error_count++;
+					decoder->state = DECODER_STATE_START;
+				}
+			}
+			break;
+
+		case DECODER_STATE_DATA:
+			//messages that don't fit are truncated (like son_recv_message())
+			s = decoder->len < decoder->size ? decoder->len : decoder->size;
+			n = s - decoder->count;
+			if( n > end - p ){
+				n = end - p;
+			}
+			memcpy(decoder->message + decoder->count, p, n);
+			p += n;
+			decoder->count += n;
+			break;
+
+		case DECODER_STATE_DISCARD:
+			n = decoder->len - decoder->count;
+			if( n > end - p ){
+				n = end - p;
+			}
+			p += n;
+			decoder->count += n;
+			if( decoder->count == decoder->len ){
+				decoder->count = 0;
+				decoder->state = DECODER_STATE_START;
+			}
+			break;
+
+		default:
+			decoder->count = 0;
+			decoder->state = DECODER_STATE_START;
+			break;
+		}
+
+		if( decoder->state == DECODER_STATE_DATA ){
+			s = decoder->len < decoder->size ? decoder->len : decoder->size;
+			if( decoder->count == s ){
+				decoder->message_count++;
+				completed++;
+				if( s < decoder->len ){
+					//skip the part that didn't fit
+					decoder->state = DECODER_STATE_DISCARD;
+				} else {
+					decoder->count = 0;
+					decoder->state = DECODER_STATE_START;
+				}
+				if( decoder->callback(decoder->context, decoder->message, s) < 0 ){
+					return -1;
+				}
+			}
+		}
+	}
+
+	return completed;
+}
+
+int son_message_buffer_fill(son_t * h, son_message_buffer_t * rx, int fd, int timeout){
+	int ret;
+	int count = 0;
+
+	//move the leftover bytes to the front to make room
+	if( rx->head ){
+		memmove(rx->buffer, rx->buffer + rx->head, rx->len);
+		rx->head = 0;
+	}
+
+	do {
+		error_number = 0;
+		ret = son_phy_read_fileno(&(h->phy), fd, rx->buffer + rx->len, rx->size - rx->len);
+		rx->read_count++;
+		if( (ret == 0) || ((ret < 0) && (error_number == ERROR_AGAIN)) ){
+			if( son_message_wait(h, fd, 0, ret == 0, &count, timeout) < 0 ){
+				return -1;
+			}
+		} else if( ret < 0 ){
+			h->err = SON_ERR_MESSAGE_IO;
+			return -1;
+		}
+	} while( ret <= 0 );
+
+	rx->len += ret;
+	return ret;
+}
+
+int son_message_buffer_find_start(son_message_buffer_t * rx){
+	u8 start[sizeof(u32)];
+	u8 * p;
+	u8 * end;
+	u32 i;
+
+	for(i=0; i < sizeof(u32); i++){
+		start[i] = (SON_MESSAGE_START >> (i*8)) & 0xff;
+	}
+
+	p = rx->buffer + rx->head;
+	end = p + rx->len;
+	while( (p = memchr(p, start[0], end - p)) != 0 ){
+		if( (size_t)(end - p) < sizeof(u32) ){
+			//keep what might be the beginning of the start for the next read
+			break;
+		}
+		if( memcmp(p, start, sizeof(u32)) == 0 ){
+			p += sizeof(u32);
+			rx->len = end - p;
+			rx->head = p - rx->buffer;
+			return 1;
+		}
+		p++;
+	}
+
+	//everything before the possible start is noise
+	if( p == 0 ){
+		p = end;
+	}
+	rx->len = end - p;
+	rx->head = p - rx->buffer;
+	return 0;
+}
+
+int son_message_buffer_take(son_t * h, son_message_buffer_t * rx, int fd, void * data, int nbytes, int timeout){
+	int n = nbytes;
+
+	if( (u32)n > rx->len ){
+		n = rx->len;
+	}
+
+	memcpy(data, rx->buffer + rx->head, n);
+	rx->head += n;
+	rx->len -= n;
+
+	//the rest is read directly so nothing past the message is consumed
+	if( n < nbytes ){
+		return son_message_transfer_data(h, fd, data + n, nbytes - n, timeout, (son_transfer_t)son_phy_read_fileno);
+	}
+	return nbytes;
+}
+
+int son_message_transfer_vector(son_t * h, int fd, son_phy_iovec_t * iov, int count, int timeout){
+	int ret;
+	int wait_count = 0;
+
+	while( 1 ){
+		while( (count > 0) && (iov->nbyte == 0) ){
+			iov++;
+			count--;
+		}
+		if( count == 0 ){
+			return 0;
+		}
+
+		error_number = 0;
+		ret = son_phy_writev_fileno(&(h->phy), fd, iov, count);
+		if( (ret == 0) || ((ret < 0) && (error_number == ERROR_AGAIN)) ){
+			if( son_message_wait(h, fd, 1, ret == 0, &wait_count, timeout) < 0 ){
+				return -1;
+			}
+		} else if( ret < 0 ){
+			h->err = SON_ERR_MESSAGE_IO;
+			return -1;
+		} else {
+			//skip what was written (the rest of a partial buffer is sent next time)
+			wait_count = 0;
+			while( (count > 0) && ((u32)ret >= iov->nbyte) ){
+				ret -= iov->nbyte;
+				iov++;
+				count--;
+			}
+			if( count > 0 ){
+				iov->buffer = (const u8*)iov->buffer + ret;
+				iov->nbyte -= ret;
+			}
+		}
+	}
+}
+
 int son_message_transfer_data(son_t * h, int fd, void *  data, int nbytes, int timeout, son_transfer_t transfer){
 	int ret;
 	int bytes = 0;
 	int count = 0;
-	do {
+	int is_write = (transfer == (son_transfer_t)son_phy_write_fileno);
+	while( bytes < nbytes ){
 		error_number = 0;
 		ret = transfer(&(h->phy), fd, data + bytes, nbytes - bytes);
-		if( ret < 0 ){
-			if( error_number == ERROR_AGAIN ){
-				son_phy_msleep(COUNT_MULT);
-				count++;
-				if( count*COUNT_MULT >= timeout ){
-					h->err = SON_ERR_MESSAGE_TIMEOUT;
-					return -1;
-				}
-			} else {
-				h->err = SON_ERR_MESSAGE_IO;
+		if( (ret == 0) || ((ret < 0) && (error_number == ERROR_AGAIN)) ){
+			if( son_message_wait(h, fd, is_write, ret == 0, &count, timeout) < 0 ){
 				return -1;
 			}
+		} else if( ret < 0 ){
+			h->err = SON_ERR_MESSAGE_IO;
+			return -1;
 		} else {
 			count = 0;
 			bytes += ret;
 		}
-	} while( bytes < nbytes );
+	}
 	return nbytes;
 }
 
+int son_message_wait(son_t * h, int fd, int is_write, int is_eof, int * count, int timeout){
+	//wakes up as soon as the descriptor is ready (sleeps where that isn't supported)
+	if( (son_phy_wait_fileno(&(h->phy), fd, is_write, COUNT_MULT) > 0) && (is_eof == 0) ){
+		//only waits that run the full period count toward the timeout
+		return 0;
+	}
+	(*count)++;
+	if( (*count)*COUNT_MULT >= timeout ){
+		h->err = SON_ERR_MESSAGE_TIMEOUT;
+		return -1;
+	}
+	return 0;
+}
+
 int son_is_message(son_t * h){
 	if( son_local_verify_checksum(h) < 0 ){ return -1; }
 
@@ -189,7 +556,8 @@ int son_message_recv_start(son_t * h, int fd, int timeout){
 		if( c == start ){
 			i++;
 		} else {
-			i = 0;
+			//the bytes of the start are all different so a mismatch can only begin a new start
+			i = (c == (SON_MESSAGE_START & 0xff));
 		}
 	} while( i < 4 );
 	return 1;
@@ -1,21 +1,75 @@
 /*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
 
+#if !defined __StratifyOS__ && !defined _FILE_OFFSET_BITS
+//use a 64-bit off_t for fseeko() on 32-bit hosts
+#define _FILE_OFFSET_BITS 64
+#endif
 
 #include <stdlib.h>
 #include <string.h>
 
 #include "son_phy.h"
 
+#if !defined __StratifyOS__ && !defined __win32 && !defined __win64
+#define SON_PHY_MMAP 1
+#define SON_PHY_PREAD 1
+#define SON_PHY_POLL 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 static int calc_bytes_left(son_phy_t * phy, int nbyte);
+#if defined __StratifyOS__ || defined __link
+//gather writes that can't use writev() are copied to a buffer on the stack
+#if defined __StratifyOS__
+#define PHY_STAGE_SIZE 64
+#else
+#define PHY_STAGE_SIZE 256
+#endif
+
+static int phy_stage(u8 * stage, const son_phy_iovec_t * iov, int count);
+#endif
+
 static int phy_read_message(son_phy_t * phy, void * buffer, u32 nbyte);
 static int phy_write_message(son_phy_t * phy, const void * buffer, u32 nbyte);
-static int phy_lseek_message(son_phy_t * phy, int32_t offset, int whence);
+static son_phy_off_t phy_lseek_message(son_phy_t * phy, son_phy_off_t offset, int whence);
+
+#if defined SON_PHY_PREAD
+static int phy_read_fileno(son_phy_t * phy, void * buffer, u32 nbyte);
+static int phy_write_fileno(son_phy_t * phy, const void * buffer, u32 nbyte);
+static son_phy_off_t phy_lseek_fileno(son_phy_t * phy, son_phy_off_t offset, int whence);
+#endif
 static int phy_close_message(son_phy_t * phy);
 
+static int phy_read_file(son_phy_t * phy, void * buffer, u32 nbyte);
+static int phy_write_file(son_phy_t * phy, const void * buffer, u32 nbyte);
+static son_phy_off_t phy_lseek_file(son_phy_t * phy, son_phy_off_t offset, int whence);
+static int phy_close_file(son_phy_t * phy);
+static void phy_track_file(son_phy_t * phy, int ret);
+
+static son_phy_page_t * cache_get_page(son_phy_t * phy, son_phy_off_t offset);
+static int cache_flush_page(son_phy_t * phy, son_phy_page_t * page);
+static int cache_read(son_phy_t * phy, void * buffer, u32 nbyte);
+static int cache_write(son_phy_t * phy, const void * buffer, u32 nbyte);
+static son_phy_off_t cache_lseek(son_phy_t * phy, son_phy_off_t offset, int whence);
+
+static int write_buffer_seek_file(son_phy_t * phy, son_phy_off_t offset);
+static int write_buffer_flush(son_phy_t * phy);
+static int write_buffer_read(son_phy_t * phy, void * buffer, u32 nbyte);
+static int write_buffer_write(son_phy_t * phy, const void * buffer, u32 nbyte);
+static son_phy_off_t write_buffer_lseek(son_phy_t * phy, son_phy_off_t offset, int whence);
+
 int son_phy_open_message(son_phy_t * phy, void * message, u32 size){
 	phy->message = 0;
 	phy->message_size = 0;
 	phy->message_offset = 0;
+	phy->cache = 0;
+	phy->write_buffer = 0;
+	phy->o_flags = 0;
 	phy->fd = -1;
 	if( message ){
 		phy->message = message;
@@ -26,6 +80,122 @@ int son_phy_open_message(son_phy_t * phy, void * message, u32 size){
 	return 0;
 }
 
+int son_phy_open_mmap(son_phy_t * phy, const char * name, int advice){
+#if defined SON_PHY_MMAP
+	struct stat st;
+	void * message;
+	int fd;
+
+	phy->message = 0;
+	phy->message_size = 0;
+	phy->message_offset = 0;
+	phy->cache = 0;
+	phy->write_buffer = 0;
+	phy->o_flags = 0;
+	phy->fd = -1;
+
+	fd = open(name, O_RDONLY);
+	if( fd < 0 ){
+		return -1;
+	}
+
+	if( (fstat(fd, &st) < 0) || (st.st_size == 0) || ((u64)st.st_size > (size_t)-1) ){
+		close(fd);
+		return -1;
+	}
+
+	message = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	//the mapping stays valid after the descriptor is closed
+	close(fd);
+	if( message == MAP_FAILED ){
+		return -1;
+	}
+
+	//the hint is optional -- ignore failures
+	if( advice == SON_MMAP_ADVICE_SEQUENTIAL ){
+		madvise(message, st.st_size, MADV_SEQUENTIAL);
+	} else if( advice == SON_MMAP_ADVICE_RANDOM ){
+		madvise(message, st.st_size, MADV_RANDOM);
+	}
+
+	//fd of -3 marks the message as mapped so that it gets unmapped on close
+	phy->message = message;
+	phy->message_size = st.st_size;
+	phy->fd = -3;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int son_phy_open_fileno(son_phy_t * phy, int fd){
+#if defined SON_PHY_PREAD
+	phy->message = 0;
+	phy->message_size = 0;
+	phy->message_offset = 0;
+	phy->cache = 0;
+	phy->write_buffer = 0;
+	phy->f = 0;
+	phy->driver = 0;
+	if( fd < 0 ){
+		return -1;
+	}
+
+	//each handle keeps its own offset so handles can share the descriptor
+	phy->fd = fd;
+	phy->file_offset = 0;
+	phy->file_op = 0;
+	phy->o_flags = SON_PHY_FLAG_FILENO;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+#if defined SON_PHY_PREAD
+int phy_read_fileno(son_phy_t * phy, void * buffer, u32 nbyte){
+	ssize_t ret = pread(phy->fd, buffer, nbyte, phy->file_offset);
+	if( ret > 0 ){
+		phy->file_offset += ret;
+	}
+	return ret;
+}
+
+int phy_write_fileno(son_phy_t * phy, const void * buffer, u32 nbyte){
+	ssize_t ret = pwrite(phy->fd, buffer, nbyte, phy->file_offset);
+	if( ret > 0 ){
+		phy->file_offset += ret;
+	}
+	return ret;
+}
+
+son_phy_off_t phy_lseek_fileno(son_phy_t * phy, son_phy_off_t offset, int whence){
+	struct stat st;
+
+	switch(whence){
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += phy->file_offset;
+		break;
+	case SEEK_END:
+		if( fstat(phy->fd, &st) < 0 ){
+			return -1;
+		}
+		offset += st.st_size;
+		break;
+	default:
+		return -1;
+	}
+
+	if( offset < 0 ){
+		return -1;
+	}
+	phy->file_offset = offset;
+	return offset;
+}
+#endif
+
 int calc_bytes_left(son_phy_t * phy, int nbyte){
 	if( phy->message_offset + nbyte >= phy->message_size ){
 		nbyte = phy->message_size - phy->message_offset;
@@ -44,7 +214,12 @@ int phy_read_message(son_phy_t * phy, void * buffer, u32 nbyte){
 }
 
 int phy_write_message(son_phy_t * phy, const void * buffer, u32 nbyte){
-	int bytes = calc_bytes_left(phy, nbyte);
+	int bytes;
+	if( phy->fd == -3 ){
+		//memory mapped files are read only
+		return -1;
+	}
+	bytes = calc_bytes_left(phy, nbyte);
 	if( bytes ){
 		memcpy(phy->message + phy->message_offset, buffer, bytes);
 		phy->message_offset += bytes;
@@ -53,12 +228,15 @@ int phy_write_message(son_phy_t * phy, const void * buffer, u32 nbyte){
 	return 0;
 }
 
-int phy_lseek_message(son_phy_t * phy, int32_t offset, int whence){
+son_phy_off_t phy_lseek_message(son_phy_t * phy, son_phy_off_t offset, int whence){
 	switch(whence){
 	case SEEK_SET: phy->message_offset = offset; break;
 	case SEEK_CUR: phy->message_offset += offset; break;
 	case SEEK_END: phy->message_offset = phy->message_size + offset; break;
 	}
+	if( phy->message_offset < 0 ){
+		phy->message_offset = 0;
+	}
 	if( phy->message_offset > phy->message_size ){
 		phy->message_offset = phy->message_size;
 	}
@@ -69,6 +247,11 @@ int phy_close_message(son_phy_t * phy){
 	if( phy->fd == -2 ){
 		free(phy->message);
 	}
+#if defined SON_PHY_MMAP
+	if( phy->fd == -3 ){
+		munmap(phy->message, phy->message_size);
+	}
+#endif
 	phy->fd = -1;
 	phy->message = 0;
 	phy->message_size = 0;
@@ -76,6 +259,546 @@ int phy_close_message(son_phy_t * phy){
 	return 0;
 }
 
+#if defined __StratifyOS__ || defined __link
+int phy_stage(u8 * stage, const son_phy_iovec_t * iov, int count){
+	u32 len = 0;
+	u32 n;
+	int i;
+	for(i=0; (i < count) && (len < PHY_STAGE_SIZE); i++){
+		n = iov[i].nbyte;
+		if( n > PHY_STAGE_SIZE - len ){
+			n = PHY_STAGE_SIZE - len;
+		}
+		memcpy(stage + len, iov[i].buffer, n);
+		len += n;
+	}
+	return len;
+}
+#endif
+
+int son_phy_set_cache(son_phy_t * phy, son_phy_cache_t * cache, void * buffer, u32 page_size, u32 page_count){
+	son_phy_off_t offset;
+
+	if( phy->message || phy->write_buffer ){
+		//messages are already in memory -- nothing to cache
+		return cache ? -1 : 0;
+	}
+
+	if( (cache != 0) &&
+			((buffer == 0) || (page_size == 0) || (page_size > 65535) || (page_count == 0) || (page_count > SON_PHY_CACHE_PAGE_MAX)) ){
+		return -1;
+	}
+
+	//write back anything held by a previous cache and sync the file position
+	offset = son_phy_lseek(phy, 0, SEEK_CUR);
+	if( offset < 0 ){
+		return -1;
+	}
+
+	if( son_phy_flush(phy) < 0 ){
+		return -1;
+	}
+	phy->cache = 0;
+
+	if( phy_lseek_file(phy, offset, SEEK_SET) < 0 ){
+		return -1;
+	}
+
+	if( cache == 0 ){
+		return 0;
+	}
+
+	memset(cache, 0, sizeof(son_phy_cache_t));
+	cache->buffer = buffer;
+	cache->page_size = page_size;
+	cache->page_count = page_count;
+	cache->offset = offset;
+	cache->phy_offset = offset;
+	phy->cache = cache;
+	return 0;
+}
+
+int son_phy_set_write_buffer(son_phy_t * phy, son_phy_write_buffer_t * write_buffer, void * buffer, u32 size){
+	son_phy_off_t offset;
+	son_phy_off_t end;
+
+	if( phy->message || phy->cache ){
+		//messages are already in memory and the cache already buffers writes
+		return write_buffer ? -1 : 0;
+	}
+
+	if( (write_buffer != 0) && ((buffer == 0) || (size == 0)) ){
+		return -1;
+	}
+
+	//write out anything held by a previous buffer and sync the file position
+	offset = son_phy_lseek(phy, 0, SEEK_CUR);
+	if( offset < 0 ){
+		return -1;
+	}
+
+	if( son_phy_flush(phy) < 0 ){
+		return -1;
+	}
+	phy->write_buffer = 0;
+
+	end = phy_lseek_file(phy, 0, SEEK_END);
+	if( (end < 0) || (phy_lseek_file(phy, offset, SEEK_SET) < 0) ){
+		return -1;
+	}
+
+	if( write_buffer == 0 ){
+		return 0;
+	}
+
+	//the buffer collects everything written past the current end of the file
+	memset(write_buffer, 0, sizeof(son_phy_write_buffer_t));
+	write_buffer->buffer = buffer;
+	write_buffer->size = size;
+	write_buffer->start = end;
+	write_buffer->offset = offset;
+	write_buffer->phy_offset = offset;
+	phy->write_buffer = write_buffer;
+	return 0;
+}
+
+int son_phy_flush(son_phy_t * phy){
+	son_phy_cache_t * cache = phy->cache;
+	u32 i;
+	int ret = 0;
+
+	if( phy->write_buffer ){
+		return write_buffer_flush(phy);
+	}
+
+	if( cache == 0 ){
+		return 0;
+	}
+
+	for(i=0; i < cache->page_count; i++){
+		if( cache_flush_page(phy, cache->page + i) < 0 ){
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+int cache_flush_page(son_phy_t * phy, son_phy_page_t * page){
+	son_phy_cache_t * cache = phy->cache;
+	int ret;
+
+	if( (page->o_flags & SON_PHY_PAGE_FLAG_DIRTY) == 0 ){
+		return 0;
+	}
+
+	//always seek before writing (stdio requires a seek when switching from reading to writing)
+	if( phy_lseek_file(phy, page->offset, SEEK_SET) < 0 ){
+		cache->phy_offset = -1;
+		return -1;
+	}
+
+	ret = phy_write_file(phy, cache->buffer + (page - cache->page)*cache->page_size, page->size);
+
+	//force a seek before the next read for the same reason
+	cache->phy_offset = -1;
+	if( ret != page->size ){
+		return -1;
+	}
+
+	cache->writeback_count++;
+	page->o_flags &= ~SON_PHY_PAGE_FLAG_DIRTY;
+	return 0;
+}
+
+son_phy_page_t * cache_get_page(son_phy_t * phy, son_phy_off_t offset){
+	son_phy_cache_t * cache = phy->cache;
+	son_phy_page_t * page;
+	son_phy_page_t * victim;
+	u8 * data;
+	son_phy_off_t page_offset;
+	u32 i;
+	int ret;
+
+	page_offset = offset - (offset % cache->page_size);
+	cache->tick++;
+
+	victim = cache->page;
+	for(i=0; i < cache->page_count; i++){
+		page = cache->page + i;
+		if( page->o_flags & SON_PHY_PAGE_FLAG_VALID ){
+			if( page->offset == page_offset ){
+				page->tick = cache->tick;
+				cache->hit_count++;
+				return page;
+			}
+			if( (victim->o_flags & SON_PHY_PAGE_FLAG_VALID) && (page->tick < victim->tick) ){
+				victim = page;
+			}
+		} else if( victim->o_flags & SON_PHY_PAGE_FLAG_VALID ){
+			//always prefer an empty page
+			victim = page;
+		}
+	}
+
+	cache->miss_count++;
+
+	//evict the least recently used page
+	if( cache_flush_page(phy, victim) < 0 ){
+		return 0;
+	}
+
+	victim->o_flags = 0;
+	data = cache->buffer + (victim - cache->page)*cache->page_size;
+	memset(data, 0, cache->page_size);
+
+	if( cache->phy_offset != page_offset ){
+		if( phy_lseek_file(phy, page_offset, SEEK_SET) < 0 ){
+			return 0;
+		}
+		cache->phy_offset = page_offset;
+	}
+
+	//a short read just means the page extends past the end of the file
+	ret = phy_read_file(phy, data, cache->page_size);
+	if( ret < 0 ){
+		cache->phy_offset = -1;
+		return 0;
+	}
+
+	cache->phy_offset += ret;
+	victim->offset = page_offset;
+	victim->size = ret;
+	victim->tick = cache->tick;
+	victim->o_flags = SON_PHY_PAGE_FLAG_VALID;
+	return victim;
+}
+
+int cache_read(son_phy_t * phy, void * buffer, u32 nbyte){
+	son_phy_cache_t * cache = phy->cache;
+	son_phy_page_t * page;
+	u32 bytes = 0;
+	u32 page_loc;
+	u32 page_bytes;
+
+	while( bytes < nbyte ){
+		page = cache_get_page(phy, cache->offset);
+		if( page == 0 ){
+			return bytes ? (int)bytes : -1;
+		}
+
+		page_loc = cache->offset - page->offset;
+		if( page_loc >= page->size ){
+			//end of file
+			break;
+		}
+
+		page_bytes = page->size - page_loc;
+		if( page_bytes > nbyte - bytes ){
+			page_bytes = nbyte - bytes;
+		}
+
+		memcpy((u8*)buffer + bytes, cache->buffer + (page - cache->page)*cache->page_size + page_loc, page_bytes);
+		bytes += page_bytes;
+		cache->offset += page_bytes;
+	}
+
+	return bytes;
+}
+
+int cache_write(son_phy_t * phy, const void * buffer, u32 nbyte){
+	son_phy_cache_t * cache = phy->cache;
+	son_phy_page_t * page;
+	u32 bytes = 0;
+	u32 page_loc;
+	u32 page_bytes;
+
+	while( bytes < nbyte ){
+		page = cache_get_page(phy, cache->offset);
+		if( page == 0 ){
+			return bytes ? (int)bytes : -1;
+		}
+
+		page_loc = cache->offset - page->offset;
+		page_bytes = cache->page_size - page_loc;
+		if( page_bytes > nbyte - bytes ){
+			page_bytes = nbyte - bytes;
+		}
+
+		memcpy(cache->buffer + (page - cache->page)*cache->page_size + page_loc, (const u8*)buffer + bytes, page_bytes);
+		if( page_loc + page_bytes > page->size ){
+			page->size = page_loc + page_bytes;
+		}
+		page->o_flags |= SON_PHY_PAGE_FLAG_DIRTY;
+		bytes += page_bytes;
+		cache->offset += page_bytes;
+	}
+
+	return bytes;
+}
+
+son_phy_off_t cache_lseek(son_phy_t * phy, son_phy_off_t offset, int whence){
+	son_phy_cache_t * cache = phy->cache;
+	son_phy_off_t end;
+
+	switch(whence){
+	case SEEK_SET:
+		cache->offset = offset;
+		break;
+	case SEEK_CUR:
+		cache->offset += offset;
+		break;
+	case SEEK_END:
+		//the file needs to be up to date to know where the end is
+		if( son_phy_flush(phy) < 0 ){
+			return -1;
+		}
+		end = phy_lseek_file(phy, 0, SEEK_END);
+		if( end < 0 ){
+			cache->phy_offset = -1;
+			return -1;
+		}
+		cache->phy_offset = end;
+		cache->offset = end + offset;
+		break;
+	default:
+		return -1;
+	}
+
+	return cache->offset;
+}
+
+int write_buffer_seek_file(son_phy_t * phy, son_phy_off_t offset){
+	son_phy_write_buffer_t * write_buffer = phy->write_buffer;
+	if( write_buffer->phy_offset != offset ){
+		if( phy_lseek_file(phy, offset, SEEK_SET) < 0 ){
+			write_buffer->phy_offset = -1;
+			return -1;
+		}
+		write_buffer->phy_offset = offset;
+	}
+	return 0;
+}
+
+int write_buffer_flush(son_phy_t * phy){
+	son_phy_write_buffer_t * write_buffer = phy->write_buffer;
+	int ret;
+
+	if( write_buffer->len == 0 ){
+		return 0;
+	}
+
+	if( write_buffer_seek_file(phy, write_buffer->start) < 0 ){
+		return -1;
+	}
+
+	ret = phy_write_file(phy, write_buffer->buffer, write_buffer->len);
+	if( ret != (int)write_buffer->len ){
+		write_buffer->phy_offset = -1;
+		return -1;
+	}
+
+	write_buffer->phy_offset += ret;
+	write_buffer->start += ret;
+	write_buffer->len = 0;
+	write_buffer->flush_count++;
+	return 0;
+}
+
+int write_buffer_read(son_phy_t * phy, void * buffer, u32 nbyte){
+	son_phy_write_buffer_t * write_buffer = phy->write_buffer;
+	son_phy_off_t end;
+	u32 bytes = 0;
+	u32 page;
+	int ret;
+
+	if( write_buffer->offset < write_buffer->start ){
+		//read the part that is already in the file
+		page = nbyte;
+		if( write_buffer->offset + page > write_buffer->start ){
+			page = write_buffer->start - write_buffer->offset;
+		}
+
+		//always seek before reading (stdio requires a seek when switching from writing to reading)
+		write_buffer->phy_offset = -1;
+		if( phy_lseek_file(phy, write_buffer->offset, SEEK_SET) < 0 ){
+			return -1;
+		}
+
+		ret = phy_read_file(phy, buffer, page);
+		if( ret < 0 ){
+			return -1;
+		}
+
+		write_buffer->offset += ret;
+		bytes = ret;
+		if( (u32)ret < page ){
+			return bytes;
+		}
+	}
+
+	end = write_buffer->start + write_buffer->len;
+	if( (bytes < nbyte) && (write_buffer->offset < end) ){
+		page = nbyte - bytes;
+		if( write_buffer->offset + page > end ){
+			page = end - write_buffer->offset;
+		}
+		memcpy((u8*)buffer + bytes, write_buffer->buffer + (write_buffer->offset - write_buffer->start), page);
+		write_buffer->offset += page;
+		bytes += page;
+	}
+
+	return bytes;
+}
+
+int write_buffer_write(son_phy_t * phy, const void * buffer, u32 nbyte){
+	son_phy_write_buffer_t * write_buffer = phy->write_buffer;
+	int ret;
+
+	if( (write_buffer->offset >= write_buffer->start) &&
+			(write_buffer->offset <= write_buffer->start + write_buffer->len) &&
+			(write_buffer->offset + nbyte > write_buffer->start + write_buffer->size) ){
+		//make room by writing what is held to the file
+		if( write_buffer_flush(phy) < 0 ){
+			return -1;
+		}
+	}
+
+	if( (write_buffer->offset >= write_buffer->start) &&
+			(write_buffer->offset <= write_buffer->start + write_buffer->len) &&
+			(write_buffer->offset + nbyte <= write_buffer->start + write_buffer->size) ){
+		memcpy(write_buffer->buffer + (write_buffer->offset - write_buffer->start), buffer, nbyte);
+		write_buffer->offset += nbyte;
+		if( write_buffer->offset > write_buffer->start + write_buffer->len ){
+			write_buffer->len = write_buffer->offset - write_buffer->start;
+		}
+		return nbyte;
+	}
+
+	//the write doesn't fit in the buffer (e.g. updating a store that has already been flushed)
+	if( write_buffer->offset + nbyte > write_buffer->start ){
+		if( write_buffer_flush(phy) < 0 ){
+			return -1;
+		}
+	}
+
+	if( write_buffer_seek_file(phy, write_buffer->offset) < 0 ){
+		return -1;
+	}
+
+	ret = phy_write_file(phy, buffer, nbyte);
+	if( ret < 0 ){
+		write_buffer->phy_offset = -1;
+		return -1;
+	}
+
+	write_buffer->phy_offset += ret;
+	write_buffer->offset += ret;
+	write_buffer->direct_count++;
+	if( write_buffer->offset > write_buffer->start ){
+		//the file grew (the buffer is empty at this point)
+		write_buffer->start = write_buffer->offset;
+	}
+	return ret;
+}
+
+son_phy_off_t write_buffer_lseek(son_phy_t * phy, son_phy_off_t offset, int whence){
+	son_phy_write_buffer_t * write_buffer = phy->write_buffer;
+
+	switch(whence){
+	case SEEK_SET:
+		write_buffer->offset = offset;
+		break;
+	case SEEK_CUR:
+		write_buffer->offset += offset;
+		break;
+	case SEEK_END:
+		write_buffer->offset = write_buffer->start + write_buffer->len + offset;
+		break;
+	default:
+		return -1;
+	}
+
+	return write_buffer->offset;
+}
+
+int son_phy_read(son_phy_t * phy, void * buffer, u32 nbyte){
+	if( phy->message ){
+		return phy_read_message(phy, buffer, nbyte);
+	}
+	if( phy->cache ){
+		return cache_read(phy, buffer, nbyte);
+	}
+	if( phy->write_buffer ){
+		return write_buffer_read(phy, buffer, nbyte);
+	}
+	return phy_read_file(phy, buffer, nbyte);
+}
+
+int son_phy_write(son_phy_t * phy, const void * buffer, u32 nbyte){
+	if( phy->o_flags & SON_PHY_FLAG_READ_ONLY ){
+		return -1;
+	}
+	if( phy->message ){
+		return phy_write_message(phy, buffer, nbyte);
+	}
+	if( phy->cache ){
+		return cache_write(phy, buffer, nbyte);
+	}
+	if( phy->write_buffer ){
+		return write_buffer_write(phy, buffer, nbyte);
+	}
+	return phy_write_file(phy, buffer, nbyte);
+}
+
+son_phy_off_t son_phy_lseek(son_phy_t * phy, son_phy_off_t offset, int whence){
+	if( phy->message ){
+		return phy_lseek_message(phy, offset, whence);
+	}
+	if( phy->cache ){
+		return cache_lseek(phy, offset, whence);
+	}
+	if( phy->write_buffer ){
+		return write_buffer_lseek(phy, offset, whence);
+	}
+	if( phy->file_offset >= 0 ){
+		//the position is tracked -- only seek if it changes
+		if( whence == SEEK_CUR ){
+			offset += phy->file_offset;
+			whence = SEEK_SET;
+		}
+		if( (whence == SEEK_SET) && (offset == phy->file_offset) ){
+			return offset;
+		}
+	}
+	return phy_lseek_file(phy, offset, whence);
+}
+
+void phy_track_file(son_phy_t * phy, int ret){
+	if( ret < 0 ){
+		phy->file_offset = -1;
+	} else if( phy->file_offset >= 0 ){
+		phy->file_offset += ret;
+	}
+}
+
+int son_phy_close(son_phy_t * phy){
+	int ret = 0;
+	if( phy->message ){
+		return phy_close_message(phy);
+	}
+
+	//dirty pages and buffered writes are written back before the file is closed
+	if( son_phy_flush(phy) < 0 ){
+		ret = -1;
+	}
+	phy->cache = 0;
+	phy->write_buffer = 0;
+
+	if( phy_close_file(phy) < 0 ){
+		ret = -1;
+	}
+	return ret;
+}
 
 
 #if !defined __StratifyOS__
@@ -95,6 +818,14 @@ void son_phy_msleep(int ms){
 #endif
 }
 
+enum {
+	PHY_FILE_OP_NONE,
+	PHY_FILE_OP_READ,
+	PHY_FILE_OP_WRITE
+};
+
+static int phy_sync_file(son_phy_t * phy, u8 op);
+
 void son_phy_set_driver(son_phy_t * phy, void * driver){
 	phy->driver = driver;
 }
@@ -103,6 +834,11 @@ int son_phy_open(son_phy_t * phy, const char * name, int32_t flags, int32_t mode
 	phy->message = 0;
 	phy->message_offset = 0;
 	phy->message_size = 0;
+	phy->cache = 0;
+	phy->write_buffer = 0;
+	phy->o_flags = 0;
+	phy->file_offset = 0;
+	phy->file_op = PHY_FILE_OP_NONE;
 	if( phy->driver == 0 ){
 		//create using fopen()
 		char open_code[8];
@@ -134,36 +870,67 @@ int son_phy_open(son_phy_t * phy, const char * name, int32_t flags, int32_t mode
 	}
 }
 
-int son_phy_read(son_phy_t * phy, void * buffer, u32 nbyte){
-	if( phy->message ){
-		return phy_read_message(phy, buffer, nbyte);
+int phy_sync_file(son_phy_t * phy, u8 op){
+	//stdio requires a seek when switching between reading and writing
+	if( (phy->file_op != PHY_FILE_OP_NONE) && (phy->file_op != op) ){
+#if defined __win32 || defined __win64
+		if( _fseeki64(phy->f, 0, SEEK_CUR) != 0 ){
+#else
+		if( fseeko(phy->f, 0, SEEK_CUR) != 0 ){
+#endif
+			return -1;
+		}
+	}
+	phy->file_op = op;
+	return 0;
+}
+
+int phy_read_file(son_phy_t * phy, void * buffer, u32 nbyte){
+	int ret;
+#if defined SON_PHY_PREAD
+	if( phy->o_flags & SON_PHY_FLAG_FILENO ){
+		return phy_read_fileno(phy, buffer, nbyte);
 	}
+#endif
 	if( phy->driver == 0 ){
 		//read using fread
-		return fread(buffer, 1, nbyte, phy->f);
+		if( phy_sync_file(phy, PHY_FILE_OP_READ) < 0 ){
+			return -1;
+		}
+		ret = fread(buffer, 1, nbyte, phy->f);
 	} else {
 #if defined __link
-		return link_read(phy->driver, phy->fd, buffer, nbyte);
+		ret = link_read(phy->driver, phy->fd, buffer, nbyte);
 #else
-		return -1;
+		ret = -1;
 #endif
 	}
+	phy_track_file(phy, ret);
+	return ret;
 }
 
-int son_phy_write(son_phy_t * phy, const void * buffer, u32 nbyte){
-	if( phy->message ){
-		return phy_write_message(phy, buffer, nbyte);
+int phy_write_file(son_phy_t * phy, const void * buffer, u32 nbyte){
+	int ret;
+#if defined SON_PHY_PREAD
+	if( phy->o_flags & SON_PHY_FLAG_FILENO ){
+		return phy_write_fileno(phy, buffer, nbyte);
 	}
+#endif
 	if( phy->driver == 0 ){
 		//write using fwrite
-		return fwrite(buffer, 1, nbyte, phy->f);
+		if( phy_sync_file(phy, PHY_FILE_OP_WRITE) < 0 ){
+			return -1;
+		}
+		ret = fwrite(buffer, 1, nbyte, phy->f);
 	} else {
 #if defined __link
-		return link_write(phy->driver, phy->fd, buffer, nbyte);
+		ret = link_write(phy->driver, phy->fd, buffer, nbyte);
 #else
-		return -1;
+		ret = -1;
 #endif
 	}
+	phy_track_file(phy, ret);
+	return ret;
 }
 
 int son_phy_read_fileno(son_phy_t * phy, int fd, void * buffer, u32 nbyte){
@@ -172,7 +939,11 @@ int son_phy_read_fileno(son_phy_t * phy, int fd, void * buffer, u32 nbyte){
 		return link_read(phy->driver, fd, buffer, nbyte);
 	}
 #endif
+#if defined SON_PHY_POLL
+	return read(fd, buffer, nbyte);
+#else
 	return -1;
+#endif
 }
 
 int son_phy_write_fileno(son_phy_t * phy, int fd, const void * buffer, u32 nbyte){
@@ -181,30 +952,102 @@ int son_phy_write_fileno(son_phy_t * phy, int fd, const void * buffer, u32 nbyte
 		return link_write(phy->driver, fd, buffer, nbyte);
 	}
 #endif
+#if defined SON_PHY_POLL
+	return write(fd, buffer, nbyte);
+#else
 	return -1;
+#endif
 }
 
-int son_phy_lseek(son_phy_t * phy, int32_t offset, int whence){
-	if( phy->message ){
-		return phy_lseek_message(phy, offset, whence);
+int son_phy_writev_fileno(son_phy_t * phy, int fd, const son_phy_iovec_t * iov, int count){
+#if defined __link
+	if( phy->driver ){
+		u8 stage[PHY_STAGE_SIZE];
+		//each link transfer is a round trip so the buffers are sent together
+		if( (count == 1) || (iov[0].nbyte >= PHY_STAGE_SIZE) ){
+			return link_write(phy->driver, fd, iov[0].buffer, iov[0].nbyte);
+		}
+		return link_write(phy->driver, fd, stage, phy_stage(stage, iov, count));
+	}
+#endif
+#if defined SON_PHY_POLL
+	struct iovec v[SON_PHY_IOV_MAX];
+	int i;
+	if( count > SON_PHY_IOV_MAX ){
+		count = SON_PHY_IOV_MAX;
+	}
+	for(i=0; i < count; i++){
+		v[i].iov_base = (void*)iov[i].buffer;
+		v[i].iov_len = iov[i].nbyte;
 	}
+	return writev(fd, v, count);
+#else
+	return -1;
+#endif
+}
+
+int son_phy_wait_fileno(son_phy_t * phy, int fd, int is_write, int ms){
+#if defined __link
+	if( phy->driver ){
+		//the link driver can't be polled
+		son_phy_msleep(ms);
+		return 0;
+	}
+#endif
+#if defined SON_PHY_POLL
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = is_write ? POLLOUT : POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, ms);
+#else
+	son_phy_msleep(ms);
+	return 0;
+#endif
+}
+
+son_phy_off_t phy_lseek_file(son_phy_t * phy, son_phy_off_t offset, int whence){
+	son_phy_off_t ret;
+
+#if defined SON_PHY_PREAD
+	if( phy->o_flags & SON_PHY_FLAG_FILENO ){
+		return phy_lseek_fileno(phy, offset, whence);
+	}
+#endif
+
 	if( phy->driver == 0 ){
-		if( fseek(phy->f, offset, whence) == 0 ){
-			return ftell(phy->f);
+		phy->file_op = PHY_FILE_OP_NONE;
+#if defined __win32 || defined __win64
+		if( _fseeki64(phy->f, offset, whence) == 0 ){
+			ret = _ftelli64(phy->f);
+		} else {
+			ret = -1;
 		}
-		return -1;
+#else
+		if( fseeko(phy->f, offset, whence) == 0 ){
+			ret = ftello(phy->f);
+		} else {
+			ret = -1;
+		}
+#endif
 	} else {
 #if defined __link
-		return link_lseek(phy->driver, phy->fd, offset, whence);
+		ret = link_lseek(phy->driver, phy->fd, offset, whence);
 #else
-		return -1;
+		ret = -1;
 #endif
 	}
+
+	phy->file_offset = ret < 0 ? -1 : ret;
+	return ret;
 }
 
-int son_phy_close(son_phy_t * phy){
-	if( phy->message ){
-		return phy_close_message(phy);
+int phy_close_file(son_phy_t * phy){
+	if( phy->o_flags & SON_PHY_FLAG_FILENO ){
+		//the descriptor belongs to the caller
+		phy->o_flags = 0;
+		phy->fd = -1;
+		return 0;
 	}
 	if( phy->driver == 0 ){
 		int ret;
@@ -235,6 +1078,10 @@ int son_phy_open(son_phy_t * phy, const char * name, int32_t flags, int32_t mode
 	phy->message = 0;
 	phy->message_offset = 0;
 	phy->message_size = 0;
+	phy->cache = 0;
+	phy->write_buffer = 0;
+	phy->o_flags = 0;
+	phy->file_offset = 0;
 	phy->fd = open(name, flags, mode);
 	if( phy->fd < 0 ){
 		return -1;
@@ -242,18 +1089,16 @@ int son_phy_open(son_phy_t * phy, const char * name, int32_t flags, int32_t mode
 	return 0;
 }
 
-int son_phy_read(son_phy_t * phy, void * buffer, u32 nbyte){
-	if( phy->message ){
-		return phy_read_message(phy, buffer, nbyte);
-	}
-	return read(phy->fd, buffer, nbyte);
+int phy_read_file(son_phy_t * phy, void * buffer, u32 nbyte){
+	int ret = read(phy->fd, buffer, nbyte);
+	phy_track_file(phy, ret);
+	return ret;
 }
 
-int son_phy_write(son_phy_t * phy, const void * buffer, u32 nbyte){
-	if( phy->message ){
-		return phy_write_message(phy, buffer, nbyte);
-	}
-	return write(phy->fd, buffer, nbyte);
+int phy_write_file(son_phy_t * phy, const void * buffer, u32 nbyte){
+	int ret = write(phy->fd, buffer, nbyte);
+	phy_track_file(phy, ret);
+	return ret;
 }
 
 int son_phy_read_fileno(son_phy_t * phy, int fd, void * buffer, u32 nbyte){
@@ -264,17 +1109,28 @@ int son_phy_write_fileno(son_phy_t * phy, int fd, const void * buffer, u32 nbyte
 	return write(fd, buffer, nbyte);
 }
 
-int son_phy_lseek(son_phy_t * phy, int32_t offset, int whence){
-	if( phy->message ){
-		return phy_lseek_message(phy, offset, whence);
+int son_phy_writev_fileno(son_phy_t * phy, int fd, const son_phy_iovec_t * iov, int count){
+	u8 stage[PHY_STAGE_SIZE];
+	if( (count == 1) || (iov[0].nbyte >= PHY_STAGE_SIZE) ){
+		return write(fd, iov[0].buffer, iov[0].nbyte);
 	}
-	return lseek(phy->fd, offset, whence);
+	return write(fd, stage, phy_stage(stage, iov, count));
 }
 
-int son_phy_close(son_phy_t * phy){
-	if( phy->message ){
-		return phy_close_message(phy);
-	}
+int son_phy_wait_fileno(son_phy_t * phy, int fd, int is_write, int ms){
+	son_phy_msleep(ms);
+	return 0;
+}
+
+son_phy_off_t phy_lseek_file(son_phy_t * phy, son_phy_off_t offset, int whence){
+	son_phy_off_t ret;
+
+	ret = lseek(phy->fd, offset, whence);
+	phy->file_offset = ret < 0 ? -1 : ret;
+	return ret;
+}
+
+int phy_close_file(son_phy_t * phy){
 	if( phy->fd >= 0 ){
 		return close(phy->fd);
 	}
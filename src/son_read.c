@@ -3,13 +3,106 @@
 
 #include "son_local.h"
 
+static int read_typed_array(son_t * h, const char * access, son_array_type_t type, void * values, u32 offset, u32 count);
+
 int son_read_str(son_t * h, const char * access, char * str, son_size_t capacity){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_str_path(h, &path, str, capacity);
+}
+
+s32 son_read_num(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_num_path(h, &path);
+}
+
+u32 son_read_unum(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_unum_path(h, &path);
+}
+
+float son_read_float(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_float_path(h, &path);
+}
+
+s64 son_read_num64(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_num64_path(h, &path);
+}
+
+u64 son_read_unum64(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_unum64_path(h, &path);
+}
+
+double son_read_double(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_double_path(h, &path);
+}
+
+int son_read_data(son_t * h, const char * access, void * data, son_size_t size){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_data_path(h, &path, data, size);
+}
+
+int son_read_view(son_t * h, const char * access, const void ** ptr, son_size_t * size, son_value_t * type){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_view_path(h, &path, ptr, size, type);
+}
+
+int son_read_bool(son_t * h, const char * access){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_read_bool_path(h, &path);
+}
+
+int son_read_array_u8(son_t * h, const char * access, u8 * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_U8, values, offset, count);
+}
+
+int son_read_array_s16(son_t * h, const char * access, s16 * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_S16, values, offset, count);
+}
+
+int son_read_array_u32(son_t * h, const char * access, u32 * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_U32, values, offset, count);
+}
+
+int son_read_array_s32(son_t * h, const char * access, s32 * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_S32, values, offset, count);
+}
+
+int son_read_array_float(son_t * h, const char * access, float * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_FLOAT, values, offset, count);
+}
+
+int son_read_array_double(son_t * h, const char * access, double * values, u32 offset, u32 count){
+	return read_typed_array(h, access, SON_ARRAY_DOUBLE, values, offset, count);
+}
+
+int son_local_read_raw_data(son_t * h, const char * access, void * data, son_size_t size, son_store_t * son){
+	son_path_t path;
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+	return son_local_read_raw_data_path(h, &path, data, size, son);
+}
+
+int son_read_str_path(son_t * h, const son_path_t * path, char * str, son_size_t capacity){
 	int data_size;
 	son_store_t son;
 	son_type_t ptype;
+	son_buffer_t value;
 	char buffer[SON_BUFFER_SIZE];
 
-	data_size = son_local_read_raw_data(h, access, str, capacity, &son);
+	data_size = son_local_read_raw_data_path(h, path, str, capacity, &son);
 	if( data_size < 0 ){
 		return -1;
 	}
@@ -17,14 +110,22 @@ int son_read_str(son_t * h, const char * access, char * str, son_size_t capacity
 	ptype.cdata = str;
 	memset(buffer, 0, SON_BUFFER_SIZE);
 
+	//str isn't necessarily aligned for 64-bit values
+	value.n_u64 = 0;
+	memcpy(&value, str, (size_t)data_size < sizeof(value) ? (size_t)data_size : sizeof(value));
+
 	switch(son_local_store_type(&son)){
 	case SON_FLOAT: snprintf(buffer, 32, "%f", *(ptype.f)); break;
 	case SON_NUMBER_U32: snprintf(buffer, 32, SON_PRINTF_INT, *(ptype.n_u32)); break;
 	case SON_NUMBER_S32: snprintf(buffer, 32, SON_PRINTF_INT, *(ptype.n_s32)); break;
+	case SON_NUMBER_S64: snprintf(buffer, 32, "%lld", (long long)(s64)value.n_u64); break;
+	case SON_NUMBER_U64: snprintf(buffer, 32, "%llu", (unsigned long long)value.n_u64); break;
+	case SON_DOUBLE: snprintf(buffer, 32, "%.17g", value.d); break;
 	case SON_TRUE: strcpy(buffer, "true"); break;
 	case SON_FALSE: strcpy(buffer, "false"); break;
 	case SON_NULL: strcpy(buffer, "null"); break;
 	case SON_DATA:
+	case SON_TYPED_ARRAY:
 	case SON_STRING:
 		return data_size;
 	}
@@ -36,28 +137,32 @@ int son_read_str(son_t * h, const char * access, char * str, son_size_t capacity
 	return data_size;
 }
 
-s32 son_read_num(son_t * h, const char * access){
+s32 son_read_num_path(son_t * h, const son_path_t * path){
 	int data_size;
 	son_store_t son;
 	son_type_t ptype;
-	char buffer[SON_BUFFER_SIZE];
+	son_buffer_t buffer;
 
-	data_size = son_local_read_raw_data(h, access, buffer, SON_BUFFER_SIZE, &son);
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
 	if( data_size < 0 ){
 		return -1;
 	}
 
-	ptype.cdata = buffer;
+	ptype.cdata = buffer.cdata;
 
 	switch(son_local_store_type(&son)){
 	case SON_FLOAT: return (int)*(ptype.f);
 	case SON_NUMBER_U32: return *(ptype.n_u32);
 	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return *(ptype.d);
 	case SON_TRUE: return 1;
 	case SON_FALSE: return 0;
 	case SON_NULL: return 0;
-	case SON_STRING: return atoi(buffer);
+	case SON_STRING: return atoi(buffer.cdata);
 	case SON_DATA:
+	case SON_TYPED_ARRAY:
 		h->err = SON_ERR_CANNOT_CONVERT;
 		return 0;
 	}
@@ -65,28 +170,32 @@ s32 son_read_num(son_t * h, const char * access){
 	return 0;
 }
 
-u32 son_read_unum(son_t * h, const char * access){
+u32 son_read_unum_path(son_t * h, const son_path_t * path){
 	int data_size;
 	son_store_t son;
 	son_type_t ptype;
-	char buffer[SON_BUFFER_SIZE];
+	son_buffer_t buffer;
 
-	data_size = son_local_read_raw_data(h, access, buffer, SON_BUFFER_SIZE, &son);
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
 	if( data_size < 0 ){
 		return -1;
 	}
 
-	ptype.cdata = buffer;
+	ptype.cdata = buffer.cdata;
 
 	switch(son_local_store_type(&son)){
 	case SON_FLOAT: return (int)*(ptype.f);
 	case SON_NUMBER_U32: return *(ptype.n_u32);
 	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return *(ptype.d);
 	case SON_TRUE: return 1;
 	case SON_FALSE: return 0;
 	case SON_NULL: return 0;
-	case SON_STRING: return atoi(buffer);
+	case SON_STRING: return atoi(buffer.cdata);
 	case SON_DATA:
+	case SON_TYPED_ARRAY:
 		h->err = SON_ERR_CANNOT_CONVERT;
 		return 0;
 	}
@@ -94,48 +203,192 @@ u32 son_read_unum(son_t * h, const char * access){
 	return 0;
 }
 
-float son_read_float(son_t * h, const char * access){
+float son_read_float_path(son_t * h, const son_path_t * path){
 	int data_size;
 	son_store_t son;
 	son_type_t ptype;
-	char buffer[SON_BUFFER_SIZE];
+	son_buffer_t buffer;
 
-	data_size = son_local_read_raw_data(h, access, buffer, SON_BUFFER_SIZE, &son);
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
 	if( data_size < 0 ){
 		return -1;
 	}
 
-	ptype.cdata = buffer;
+	ptype.cdata = buffer.cdata;
 
 	switch(son_local_store_type(&son)){
 	case SON_FLOAT: return *(ptype.f);
 	case SON_NUMBER_U32: return *(ptype.n_u32);
 	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return *(ptype.d);
 	case SON_TRUE: return 1.0;
 	case SON_FALSE: return 0.0;
 	case SON_NULL: return 0.0;
 #if defined __StratifyOS__
-	case SON_STRING: return atoff(buffer);
+	case SON_STRING: return atoff(buffer.cdata);
 #else
-	case SON_STRING: return atof(buffer);
+	case SON_STRING: return atof(buffer.cdata);
 #endif
-	case SON_DATA: return 0.0;
+	case SON_DATA:
+	case SON_TYPED_ARRAY:
+		h->err = SON_ERR_CANNOT_CONVERT;
+		return 0.0;
 	}
 
 	return 0.0;
 }
 
-int son_read_data(son_t * h, const char * access, void * data, son_size_t size){
+s64 son_read_num64_path(son_t * h, const son_path_t * path){
+	int data_size;
+	son_store_t son;
+	son_type_t ptype;
+	son_buffer_t buffer;
+
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
+	if( data_size < 0 ){
+		return -1;
+	}
+
+	ptype.cdata = buffer.cdata;
+
+	switch(son_local_store_type(&son)){
+	case SON_FLOAT: return (s64)*(ptype.f);
+	case SON_NUMBER_U32: return *(ptype.n_u32);
+	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return (s64)*(ptype.d);
+	case SON_TRUE: return 1;
+	case SON_FALSE: return 0;
+	case SON_NULL: return 0;
+	case SON_STRING: return strtoll(buffer.cdata, 0, 10);
+	case SON_DATA:
+	case SON_TYPED_ARRAY:
+		h->err = SON_ERR_CANNOT_CONVERT;
+		return 0;
+	}
+
+	return 0;
+}
+
+u64 son_read_unum64_path(son_t * h, const son_path_t * path){
+	int data_size;
+	son_store_t son;
+	son_type_t ptype;
+	son_buffer_t buffer;
+
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
+	if( data_size < 0 ){
+		return -1;
+	}
+
+	ptype.cdata = buffer.cdata;
+
+	switch(son_local_store_type(&son)){
+	case SON_FLOAT: return (u64)*(ptype.f);
+	case SON_NUMBER_U32: return *(ptype.n_u32);
+	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return (u64)*(ptype.d);
+	case SON_TRUE: return 1;
+	case SON_FALSE: return 0;
+	case SON_NULL: return 0;
+	case SON_STRING: return strtoull(buffer.cdata, 0, 10);
+	case SON_DATA:
+	case SON_TYPED_ARRAY:
+		h->err = SON_ERR_CANNOT_CONVERT;
+		return 0;
+	}
+
+	return 0;
+}
+
+double son_read_double_path(son_t * h, const son_path_t * path){
+	int data_size;
 	son_store_t son;
-	return son_local_read_raw_data(h, access, data, size, &son);
+	son_type_t ptype;
+	son_buffer_t buffer;
+
+	data_size = son_local_read_raw_data_path(h, path, buffer.cdata, SON_BUFFER_SIZE, &son);
+	if( data_size < 0 ){
+		return -1;
+	}
+
+	ptype.cdata = buffer.cdata;
+
+	switch(son_local_store_type(&son)){
+	case SON_FLOAT: return *(ptype.f);
+	case SON_NUMBER_U32: return *(ptype.n_u32);
+	case SON_NUMBER_S32: return *(ptype.n_s32);
+	case SON_NUMBER_S64: return *(ptype.n_s64);
+	case SON_NUMBER_U64: return *(ptype.n_u64);
+	case SON_DOUBLE: return *(ptype.d);
+	case SON_TRUE: return 1.0;
+	case SON_FALSE: return 0.0;
+	case SON_NULL: return 0.0;
+	case SON_STRING: return strtod(buffer.cdata, 0);
+	case SON_DATA:
+	case SON_TYPED_ARRAY:
+		h->err = SON_ERR_CANNOT_CONVERT;
+		return 0.0;
+	}
+
+	return 0.0;
+}
+
+int son_read_data_path(son_t * h, const son_path_t * path, void * data, son_size_t size){
+	son_store_t son;
+	return son_local_read_raw_data_path(h, path, data, size, &son);
+}
+
+int son_read_view_path(son_t * h, const son_path_t * path, const void ** ptr, son_size_t * size, son_value_t * type){
+	son_size_t data_size;
+	son_store_t son;
+	son_phy_off_t pos;
+	int ret = 0;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	//views point directly in to the message so they only work on memory
+	if( h->stack_size != 0 ){
+		h->err = SON_ERR_CANNOT_READ;
+		ret = -1;
+	} else if( h->phy.message == 0 ){
+		h->err = SON_ERR_NO_MESSAGE;
+		ret = -1;
+	} else if( son_local_store_seek_path(h, path, &son, &data_size) < 0 ){
+		ret = -1;
+	} else {
+		pos = son_local_phy_lseek_current(h, 0);
+		if( pos < 0 ){
+			ret = -1;
+		} else {
+			//don't let a corrupt size point beyond the end of the message
+			if( pos + (son_phy_off_t)data_size > h->phy.message_size ){
+				data_size = h->phy.message_size - pos;
+			}
+
+			*ptr = (const u8*)h->phy.message + pos;
+			if( size ){ *size = data_size; }
+			if( type ){ *type = son_local_store_type(&son); }
+			ret = data_size;
+		}
+	}
+
+	son_local_assign_checksum(h);
+
+	return ret;
 }
 
-int son_read_bool(son_t *h, const char * key){
+int son_read_bool_path(son_t * h, const son_path_t * path){
 	int data_size;
 	son_store_t son;
 	char buffer[SON_BUFFER_SIZE];
 
-	data_size = son_local_read_raw_data(h,key,buffer,SON_BUFFER_SIZE,&son);
+	data_size = son_local_read_raw_data_path(h, path, buffer, SON_BUFFER_SIZE, &son);
 
 	if(data_size < 0){
 		return -1;
@@ -151,7 +404,7 @@ int son_read_bool(son_t *h, const char * key){
 	return 0;
 }
 
-int son_local_read_raw_data(son_t * h, const char * access, void * data, son_size_t size, son_store_t * son){
+int son_local_read_raw_data_path(son_t * h, const son_path_t * path, void * data, son_size_t size, son_store_t * son){
 	son_size_t data_size;
 	int ret = 0;
 
@@ -162,7 +415,7 @@ int son_local_read_raw_data(son_t * h, const char * access, void * data, son_siz
 		h->err = SON_ERR_CANNOT_READ;
 		ret = -1;
 	} else {
-		if( son_local_store_seek(h, access, son, &data_size) < 0 ){
+		if( son_local_store_seek_path(h, path, son, &data_size) < 0 ){
 			ret = -1;
 		} else {
 			memset(data, 0, size);
@@ -170,7 +423,7 @@ int son_local_read_raw_data(son_t * h, const char * access, void * data, son_siz
 				data_size = size;
 			}
 
-			if( son_phy_read(&(h->phy), data, data_size) != data_size ){
+			if( son_phy_read(&(h->phy), data, data_size) != (int)data_size ){
 				h->err = SON_ERR_READ_IO;
 				ret = -1;
 			} else {
@@ -183,3 +436,54 @@ int son_local_read_raw_data(son_t * h, const char * access, void * data, son_siz
 
 	return ret;
 }
+
+int read_typed_array(son_t * h, const char * access, son_array_type_t type, void * values, u32 offset, u32 count){
+	son_typed_array_hdr_t hdr;
+	son_size_t data_size;
+	son_size_t total;
+	son_size_t size;
+	son_store_t son;
+	son_path_t path;
+	int ret = 0;
+
+	if( son_local_path_compile(h, &path, access) < 0 ){ return -1; }
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	//check to see if h is open for reading
+	if( h->stack_size != 0 ){
+		h->err = SON_ERR_CANNOT_READ;
+		ret = -1;
+	} else if( son_local_store_seek_path(h, &path, &son, &data_size) < 0 ){
+		ret = -1;
+	} else if( (son_local_store_type(&son) != SON_TYPED_ARRAY) ||
+			(data_size < sizeof(hdr)) ||
+			(son_phy_read(&(h->phy), &hdr, sizeof(hdr)) != sizeof(hdr)) ||
+			(hdr.type != type) ||
+			(hdr.size != son_local_array_type_size(type)) ){
+		h->err = SON_ERR_CANNOT_CONVERT;
+		ret = -1;
+	} else {
+		total = (data_size - sizeof(hdr)) / hdr.size;
+		if( values == 0 ){
+			ret = total;
+		} else if( offset < total ){
+			if( count > total - offset ){
+				count = total - offset;
+			}
+
+			//copy the whole range with one read
+			size = (son_size_t)count * hdr.size;
+			if( (son_local_phy_lseek_current(h, (son_phy_off_t)offset * hdr.size) < 0) ||
+					(son_phy_read(&(h->phy), values, size) != (int)size) ){
+				h->err = SON_ERR_READ_IO;
+				ret = -1;
+			} else {
+				ret = count;
+			}
+		}
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
@@ -0,0 +1,310 @@
+/*! \file */ //Copyright 2011-2017 Tyler Gilbert; All Rights Reserved
+
+#include "son_local.h"
+
+#if !defined __StratifyOS__ && !defined __win32 && !defined __win64
+#define SON_RING_SHM 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#if defined __linux__
+#define SON_RING_FUTEX 1
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define SON_RING_MAGIC 0x52494e47
+#define SON_RING_ALIGN 64
+
+/*
+ * Each slot has a sequence number (bounded MPMC queue by D. Vyukov):
+ *
+ * sequence == pos: the slot is free for the producer that reserves pos
+ * sequence == pos + 1: the message is ready for the consumer
+ * sequence == pos + slot_count: the slot was released (free for the next lap)
+ *
+ */
+typedef struct {
+	volatile u32 sequence;
+	u32 size;
+} ring_slot_t;
+
+static ring_slot_t * ring_slot(son_ring_t * ring, u32 pos);
+static ring_slot_t * ring_slot_from_message(son_ring_t * ring, void * message);
+static u32 ring_stride(u32 slot_size);
+static int ring_wait(son_ring_t * ring, u32 signal, int ms);
+
+u32 son_get_ring_size(u32 slot_size, u32 slot_count){
+	return sizeof(son_ring_t) + slot_count * ring_stride(slot_size);
+}
+
+int son_init_ring(son_ring_t * ring, u32 slot_size, u32 slot_count){
+	u32 i;
+
+	if( (slot_size < sizeof(son_hdr_t)) || (slot_count == 0) || (slot_count & (slot_count - 1)) ){
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(son_ring_t));
+	ring->slot_size = slot_size;
+	ring->slot_count = slot_count;
+	ring->stride = ring_stride(slot_size);
+	for(i=0; i < slot_count; i++){
+		ring_slot(ring, i)->sequence = i;
+		ring_slot(ring, i)->size = 0;
+	}
+
+	//other processes wait for the magic number before using the ring
+	__atomic_store_n(&(ring->magic), SON_RING_MAGIC, __ATOMIC_RELEASE);
+	return 0;
+}
+
+son_ring_t * son_open_ring(const char * name, u32 slot_size, u32 slot_count){
+#if defined SON_RING_SHM
+	son_ring_t * ring;
+	struct stat st;
+	u32 size;
+	int is_creator = 1;
+	int fd;
+	int i;
+
+	if( (slot_count == 0) || (slot_count & (slot_count - 1)) ){
+		return 0;
+	}
+	size = son_get_ring_size(slot_size, slot_count);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+	if( fd < 0 ){
+		is_creator = 0;
+		fd = shm_open(name, O_RDWR, 0666);
+		if( fd < 0 ){
+			return 0;
+		}
+		//the creator might not have set the size yet
+		for(i=0; i < 1000; i++){
+			if( fstat(fd, &st) < 0 ){
+				close(fd);
+				return 0;
+			}
+			if( st.st_size != 0 ){
+				break;
+			}
+			son_phy_msleep(1);
+		}
+		if( st.st_size != size ){
+			close(fd);
+			return 0;
+		}
+	} else if( ftruncate(fd, size) < 0 ){
+		close(fd);
+		return 0;
+	}
+
+	ring = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	//the mapping stays valid after the descriptor is closed
+	close(fd);
+	if( ring == MAP_FAILED ){
+		return 0;
+	}
+
+	if( is_creator ){
+		son_init_ring(ring, slot_size, slot_count);
+	} else {
+		for(i=0; i < 1000; i++){
+			if( __atomic_load_n(&(ring->magic), __ATOMIC_ACQUIRE) == SON_RING_MAGIC ){
+				break;
+			}
+			son_phy_msleep(1);
+		}
+		if( (ring->magic != SON_RING_MAGIC) || (ring->slot_size != slot_size) || (ring->slot_count != slot_count) ){
+			munmap(ring, size);
+			return 0;
+		}
+	}
+
+	return ring;
+#else
+	return 0;
+#endif
+}
+
+int son_close_ring(son_ring_t * ring){
+#if defined SON_RING_SHM
+	return munmap(ring, son_get_ring_size(ring->slot_size, ring->slot_count));
+#else
+	return -1;
+#endif
+}
+
+int son_unlink_ring(const char * name){
+#if defined SON_RING_SHM
+	return shm_unlink(name);
+#else
+	return -1;
+#endif
+}
+
+int son_create_ring_message(son_ring_t * ring, son_t * h, son_stack_t * stack, son_size_t stack_size){
+	ring_slot_t * slot;
+	u32 pos;
+	u32 seq;
+	s32 diff;
+
+	pos = __atomic_load_n(&(ring->head), __ATOMIC_RELAXED);
+	do {
+		slot = ring_slot(ring, pos);
+		seq = __atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE);
+		diff = (s32)(seq - pos);
+		if( diff == 0 ){
+			//the slot is free -- claim it (another producer may get there first)
+			if( __atomic_compare_exchange_n(&(ring->head), &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ){
+				break;
+			}
+		} else if( diff < 0 ){
+			//the consumer hasn't released the slot from the last lap
+			h->err = SON_ERR_RING_FULL;
+			return -1;
+		} else {
+			pos = __atomic_load_n(&(ring->head), __ATOMIC_RELAXED);
+		}
+	} while( 1 );
+
+	//the message is built directly in the slot
+	return son_create_message(h, slot + 1, ring->slot_size, stack, stack_size);
+}
+
+int son_send_ring_message(son_ring_t * ring, son_t * h){
+	ring_slot_t * slot;
+	int nbytes;
+
+	slot = ring_slot_from_message(ring, h->phy.message);
+	if( slot == 0 ){
+		h->err = SON_ERR_NO_MESSAGE;
+		return -1;
+	}
+
+	if( son_close(h) < 0 ){
+		nbytes = -1;
+		slot->size = 0;
+	} else {
+		//an empty message still needs to be passed on so that the slot is released
+		son_open_message(h, slot + 1, ring->slot_size);
+		nbytes = son_get_message_size(h);
+		son_close(h);
+		slot->size = nbytes < 0 ? 0 : nbytes;
+	}
+
+	//the slot still has the sequence it was reserved with
+	__atomic_store_n(&(slot->sequence), slot->sequence + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&(ring->signal), 1, __ATOMIC_SEQ_CST);
+	if( __atomic_load_n(&(ring->waiting), __ATOMIC_SEQ_CST) ){
+#if defined SON_RING_FUTEX
+		syscall(SYS_futex, &(ring->signal), FUTEX_WAKE, 1, 0, 0, 0);
+#endif
+	}
+
+	return nbytes;
+}
+
+int son_recv_ring_message(son_ring_t * ring, son_t * h, int timeout){
+	ring_slot_t * slot;
+	u32 pos;
+	u32 signal;
+	int ret;
+
+	pos = ring->tail;
+	slot = ring_slot(ring, pos);
+
+	while( __atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE) != pos + 1 ){
+		if( timeout <= 0 ){
+			h->err = SON_ERR_MESSAGE_TIMEOUT;
+			return -1;
+		}
+
+		//check again after announcing the wait so that a wake up isn't missed
+		__atomic_store_n(&(ring->waiting), 1, __ATOMIC_SEQ_CST);
+		signal = __atomic_load_n(&(ring->signal), __ATOMIC_SEQ_CST);
+		if( __atomic_load_n(&(slot->sequence), __ATOMIC_ACQUIRE) != pos + 1 ){
+			timeout -= ring_wait(ring, signal, timeout);
+		}
+		__atomic_store_n(&(ring->waiting), 0, __ATOMIC_SEQ_CST);
+	}
+
+	if( son_open_message(h, slot + 1, ring->slot_size) < 0 ){
+		return -1;
+	}
+
+	ret = slot->size;
+	if( ret == 0 ){
+		//the producer failed to create the message -- skip the slot
+		son_release_ring_message(ring, h);
+		h->err = SON_ERR_INCOMPLETE_MESSAGE;
+		return -1;
+	}
+	return ret;
+}
+
+int son_release_ring_message(son_ring_t * ring, son_t * h){
+	ring_slot_t * slot;
+	u32 pos = ring->tail;
+
+	slot = ring_slot(ring, pos);
+	if( ring_slot_from_message(ring, h->phy.message) != slot ){
+		h->err = SON_ERR_NO_MESSAGE;
+		return -1;
+	}
+
+	son_close(h);
+
+	//the slot is free for the producers on the next lap
+	ring->tail = pos + 1;
+	__atomic_store_n(&(slot->sequence), pos + ring->slot_count, __ATOMIC_RELEASE);
+	return 0;
+}
+
+ring_slot_t * ring_slot(son_ring_t * ring, u32 pos){
+	return (ring_slot_t*)((u8*)ring + sizeof(son_ring_t) + (pos & (ring->slot_count - 1)) * ring->stride);
+}
+
+ring_slot_t * ring_slot_from_message(son_ring_t * ring, void * message){
+	u8 * slots = (u8*)ring + sizeof(son_ring_t);
+	u32 offset;
+
+	if( (u8*)message < slots + sizeof(ring_slot_t) ){
+		return 0;
+	}
+
+	offset = (u8*)message - sizeof(ring_slot_t) - slots;
+	if( (offset % ring->stride) || (offset / ring->stride >= ring->slot_count) ){
+		return 0;
+	}
+	return (ring_slot_t*)(slots + offset);
+}
+
+u32 ring_stride(u32 slot_size){
+	//each slot starts on its own cache line
+	return (sizeof(ring_slot_t) + slot_size + SON_RING_ALIGN - 1) & ~(SON_RING_ALIGN - 1);
+}
+
+int ring_wait(son_ring_t * ring, u32 signal, int ms){
+#if defined SON_RING_FUTEX
+	struct timespec start;
+	struct timespec end;
+	struct timespec ts;
+
+	//sleeps until a producer changes the signal (or the timeout)
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	syscall(SYS_futex, &(ring->signal), FUTEX_WAIT, signal, &ts, 0, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec)*1000 + (end.tv_nsec - start.tv_nsec)/1000000;
+#else
+	son_phy_msleep(1);
+	return 1;
+#endif
+}
@@ -4,8 +4,13 @@
 #include "son_local.h"
 
 static int write_raw_data(son_t * h, const char * key, son_value_t type, const void * v, son_size_t size);
+static int write_typed_array(son_t * h, const char * key, son_array_type_t type, const void * v, u32 count);
 static int write_open_type(son_t * h, const char * key, u8 type);
 static int write_close_type(son_t * h);
+static son_phy_off_t write_index(son_t * h, son_store_t * store, son_size_t pos, son_size_t end);
+static son_phy_off_t write_key_index(son_t * h, son_size_t pos, son_size_t end, u32 count);
+static son_phy_off_t write_array_table(son_t * h, son_size_t pos, son_size_t end, u32 count);
+static int count_members(son_t * h, son_size_t pos, son_size_t end);
 
 int son_close(son_t * h){
 	int ret;
@@ -18,8 +23,24 @@ int son_close(son_t * h){
 		}
 	}
 
+	if( (h->o_flags & SON_FLAG_CRC) &&
+			((h->stack != 0) || (h->o_flags & SON_LOCAL_FLAG_MODIFIED)) ){
+		if( son_local_crc_write(h) < 0 ){
+			son_phy_close(&(h->phy));
+			h->phy.fd = -1;
+			return -1;
+		}
+	}
+
 	ret = son_phy_close(&(h->phy));
 	h->phy.fd = -1;
+	if( h->doc != 0 ){
+		//handles opened with son_open_doc() share the document's memory
+		if( son_local_doc_release(h->doc) < 0 ){
+			ret = -1;
+		}
+		h->doc = 0;
+	}
 	if( ret < 0 ){
 		h->err = SON_ERR_CLOSE_IO;
 	}
@@ -35,6 +56,10 @@ int son_close_object(son_t * h){
 	return write_close_type(h);
 }
 
+int son_local_write_open_type(son_t * h, const char * key, u8 type){
+	return write_open_type(h, key, type);
+}
+
 int son_open_data(son_t * h, const char * key){
 	return write_open_type(h, key, SON_DATA);
 }
@@ -68,6 +93,18 @@ int son_write_float(son_t * h, const char * key, float v){
 	return write_raw_data(h, key, SON_FLOAT, &v, sizeof(float));
 }
 
+int son_write_num64(son_t * h, const char * key, s64 v){
+	return write_raw_data(h, key, SON_NUMBER_S64, &v, sizeof(v));
+}
+
+int son_write_unum64(son_t * h, const char * key, u64 v){
+	return write_raw_data(h, key, SON_NUMBER_U64, &v, sizeof(v));
+}
+
+int son_write_double(son_t * h, const char * key, double v){
+	return write_raw_data(h, key, SON_DOUBLE, &v, sizeof(double));
+}
+
 int son_write_true(son_t * h, const char * key){
 	return write_raw_data(h, key, SON_TRUE, 0, 0);
 }
@@ -95,9 +132,33 @@ int son_write_open_data(son_t * h, const void * v, son_size_t size){
 	return ret;
 }
 
+int son_write_array_u8(son_t * h, const char * key, const u8 * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_U8, values, count);
+}
+
+int son_write_array_s16(son_t * h, const char * key, const s16 * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_S16, values, count);
+}
+
+int son_write_array_u32(son_t * h, const char * key, const u32 * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_U32, values, count);
+}
+
+int son_write_array_s32(son_t * h, const char * key, const s32 * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_S32, values, count);
+}
+
+int son_write_array_float(son_t * h, const char * key, const float * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_FLOAT, values, count);
+}
+
+int son_write_array_double(son_t * h, const char * key, const double * values, u32 count){
+	return write_typed_array(h, key, SON_ARRAY_DOUBLE, values, count);
+}
+
 int write_open_type(son_t * h, const char * key, u8 type){
 	son_store_t store;
-	size_t pos;
+	son_size_t pos;
 	int ret = 0;
 
 	if( son_local_verify_checksum(h) < 0 ){ return -1; }
@@ -140,6 +201,7 @@ int write_close_type(son_t * h){
 	son_size_t pos;
 	son_size_t current;
 	son_store_t store;
+	son_phy_off_t end;
 	int ret = 0;
 
 	if( son_local_verify_checksum(h) < 0 ){ return -1; }
@@ -158,7 +220,11 @@ int write_close_type(son_t * h){
 			//read the current store
 			if( son_local_store_read(h, &store) < 0 ){
 				ret = -1;
+			} else if( (end = write_index(h, &store, pos, current)) < 0 ){
+				ret = -1;
 			} else {
+				//the index (if any) is part of the object
+				current = end;
 
 				//seek back to the store position
 				if( son_local_phy_lseek_set(h, pos) < 0 ){
@@ -192,7 +258,7 @@ int write_close_type(son_t * h){
 }
 
 int write_raw_data(son_t * h, const char * key, son_value_t type, const void * v, son_size_t size){
-	size_t pos;
+	son_size_t pos;
 	son_store_t store;
 	int ret;
 
@@ -217,16 +283,12 @@ int write_raw_data(son_t * h, const char * key, son_value_t type, const void * v
 
 
 			pos = son_local_phy_lseek_current(h, 0);
-			son_local_store_set_next(&store, pos + sizeof(son_store_t) + size);
+			son_local_store_set_next(&store, pos + son_local_store_size(h) + size);
 
-			if( son_local_store_write(h, &store) != 0 ){
+			if( son_local_store_write_value(h, &store, v, size) != 0 ){
 				ret = -1;
 			} else {
-
-				ret = son_phy_write(&(h->phy), v, size);
-				if( ret < 0 ){
-					h->err = SON_ERR_WRITE_IO;
-				}
+				ret = size;
 			}
 		}
 	}
@@ -234,3 +296,268 @@ int write_raw_data(son_t * h, const char * key, son_value_t type, const void * v
 	son_local_assign_checksum(h);
 	return ret;
 }
+
+int write_typed_array(son_t * h, const char * key, son_array_type_t type, const void * v, u32 count){
+	son_typed_array_hdr_t hdr;
+	son_size_t size;
+	son_size_t pos;
+	son_store_t store;
+	int ret;
+
+	if( son_local_verify_checksum(h) < 0 ){ return -1; }
+
+	hdr.type = type;
+	hdr.size = son_local_array_type_size(type);
+	hdr.resd = 0;
+	size = (son_size_t)count * hdr.size;
+
+	if( h->stack_size == 0 ){
+		//stack size is set to zero when the file is opened for read only
+		h->err = SON_ERR_CANNOT_WRITE;
+		ret = -1;
+	} else if ( (key == 0) || (key[0] == 0) ){
+		h->err = SON_ERR_INVALID_KEY;
+		ret = -1;
+	} else if( h->stack_loc == 0 ){
+		h->err = SON_ERR_NO_ROOT;
+		ret = -1;
+	} else {
+
+		son_local_store_insert_key(&store, key);
+		son_local_store_set_type(&store, SON_TYPED_ARRAY);
+
+		pos = son_local_phy_lseek_current(h, 0);
+		son_local_store_set_next(&store, pos + son_local_store_size(h) + sizeof(hdr) + size);
+
+		if( son_local_store_write_value(h, &store, &hdr, sizeof(hdr)) != 0 ){
+			ret = -1;
+		} else if( (size > 0) && (son_phy_write(&(h->phy), v, size) != (int)size) ){
+			//all the elements are written at once
+			h->err = SON_ERR_WRITE_IO;
+			ret = -1;
+		} else {
+			ret = size;
+		}
+	}
+
+	son_local_assign_checksum(h);
+	return ret;
+}
+
+son_phy_off_t write_index(son_t * h, son_store_t * store, son_size_t pos, son_size_t end){
+	int count;
+
+	//returns the new end of the object or array
+	store->o_flags &= ~SON_STORE_FLAG_INDEXED;
+
+	if( end - pos > (u32)-1 ){
+		//index offsets are 32-bit
+		return end;
+	}
+
+	if( (h->o_flags & SON_FLAG_INDEX_OBJECTS) && (son_local_store_type(store) == SON_OBJ) ){
+		count = count_members(h, pos, end);
+		if( count < 0 ){
+			return -1;
+		}
+
+		if( count >= SON_INDEX_MIN_COUNT ){
+			store->o_flags |= SON_STORE_FLAG_INDEXED;
+			return write_key_index(h, pos, end, count);
+		}
+	}
+
+	if( (h->o_flags & SON_FLAG_INDEX_ARRAYS) && (son_local_store_type(store) == SON_ARRAY) ){
+		count = count_members(h, pos, end);
+		if( count < 0 ){
+			return -1;
+		}
+
+		if( count >= SON_INDEX_MIN_COUNT ){
+			store->o_flags |= SON_STORE_FLAG_INDEXED;
+			return write_array_table(h, pos, end, count);
+		}
+	}
+
+	return end;
+}
+
+int count_members(son_t * h, son_size_t pos, son_size_t end){
+	son_store_t store;
+	son_size_t child;
+	son_size_t next;
+	int count = 0;
+
+	child = pos + son_local_store_size(h);
+	while( child < end ){
+		if( (son_local_phy_lseek_set(h, child) < 0) || (son_local_store_read(h, &store) <= 0) ){
+			return -1;
+		}
+
+		next = son_local_store_next(&store);
+		if( next <= child ){
+			//members must be closed before the parent
+			h->err = SON_ERR_INVALID_ROOT;
+			return -1;
+		}
+
+		//old indexes (left behind by son_append()) are not members
+		if( (son_local_store_flags(&store) & SON_STORE_FLAG_INDEX) == 0 ){
+			count++;
+		}
+		child = next;
+	}
+
+	return count;
+}
+
+son_phy_off_t write_key_index(son_t * h, son_size_t pos, son_size_t end, u32 count){
+	son_store_t store;
+	son_index_trailer_t trailer;
+	son_index_slot_t slot;
+	son_index_slot_t empty[8];
+	son_size_t slots;
+	son_size_t child;
+	son_size_t next;
+	u32 i;
+	u32 n;
+
+	//use a power of two table that is at most half full
+	trailer.stride = 0;
+	trailer.count = 1;
+	while( trailer.count < count*2 ){
+		trailer.count <<= 1;
+	}
+
+	slots = end + son_local_store_size(h);
+
+	//write the index marker followed by empty slots and the trailer
+	son_local_store_insert_key(&store, SON_INDEX_KEY);
+	son_local_store_set_type(&store, SON_DATA);
+	store.o_flags |= SON_STORE_FLAG_INDEX;
+	son_local_store_set_next(&store, slots + trailer.count*sizeof(slot) + sizeof(trailer));
+
+	if( (son_local_phy_lseek_set(h, end) < 0) || (son_local_store_write(h, &store) < 0) ){
+		return -1;
+	}
+
+	memset(empty, 0, sizeof(empty));
+	for(i=0; i < trailer.count; i += n){
+		n = trailer.count - i;
+		if( n > sizeof(empty)/sizeof(son_index_slot_t) ){
+			n = sizeof(empty)/sizeof(son_index_slot_t);
+		}
+		if( son_phy_write(&(h->phy), empty, n*sizeof(son_index_slot_t)) != (int)(n*sizeof(son_index_slot_t)) ){
+			h->err = SON_ERR_WRITE_IO;
+			return -1;
+		}
+	}
+
+	if( son_phy_write(&(h->phy), &trailer, sizeof(trailer)) != sizeof(trailer) ){
+		h->err = SON_ERR_WRITE_IO;
+		return -1;
+	}
+
+	//add each member to the table using linear probing
+	child = pos + son_local_store_size(h);
+	while( child < end ){
+		if( (son_local_phy_lseek_set(h, child) < 0) || (son_local_store_read(h, &store) <= 0) ){
+			return -1;
+		}
+		next = son_local_store_next(&store);
+
+		if( (son_local_store_flags(&store) & SON_STORE_FLAG_INDEX) == 0 ){
+			i = son_local_key_hash(store.key.name) & (trailer.count - 1);
+			do {
+				if( (son_local_phy_lseek_set(h, slots + i*sizeof(slot)) < 0) ||
+						(son_phy_read(&(h->phy), &slot, sizeof(slot)) != sizeof(slot)) ){
+					h->err = SON_ERR_READ_IO;
+					return -1;
+				}
+
+				if( slot.offset == 0 ){
+					break;
+				}
+
+				i = (i+1) & (trailer.count - 1);
+			} while( 1 );
+
+			slot.hash = son_local_key_hash(store.key.name);
+			slot.offset = child - pos;
+
+			if( (son_local_phy_lseek_set(h, slots + i*sizeof(slot)) < 0) ||
+					(son_phy_write(&(h->phy), &slot, sizeof(slot)) != sizeof(slot)) ){
+				h->err = SON_ERR_WRITE_IO;
+				return -1;
+			}
+		}
+
+		child = next;
+	}
+
+	return slots + trailer.count*sizeof(slot) + sizeof(trailer);
+}
+
+son_phy_off_t write_array_table(son_t * h, son_size_t pos, son_size_t end, u32 count){
+	son_store_t store;
+	son_index_trailer_t trailer;
+	u32 offsets[16];
+	son_size_t table;
+	son_size_t child;
+	son_size_t next;
+	u32 entries;
+	u32 element;
+	u32 n;
+
+	trailer.count = count;
+	trailer.stride = SON_INDEX_ARRAY_STRIDE > 0 ? SON_INDEX_ARRAY_STRIDE : 1;
+	entries = (count + trailer.stride - 1) / trailer.stride;
+	table = end + son_local_store_size(h);
+
+	son_local_store_insert_key(&store, SON_INDEX_KEY);
+	son_local_store_set_type(&store, SON_DATA);
+	store.o_flags |= SON_STORE_FLAG_INDEX;
+	son_local_store_set_next(&store, table + entries*sizeof(u32) + sizeof(trailer));
+
+	if( (son_local_phy_lseek_set(h, end) < 0) || (son_local_store_write(h, &store) < 0) ){
+		return -1;
+	}
+
+	//walk the elements and write the offsets in batches to limit seeking
+	child = pos + son_local_store_size(h);
+	element = 0;
+	n = 0;
+	while( child < end ){
+		if( (son_local_phy_lseek_set(h, child) < 0) || (son_local_store_read(h, &store) <= 0) ){
+			return -1;
+		}
+		next = son_local_store_next(&store);
+
+		if( (son_local_store_flags(&store) & SON_STORE_FLAG_INDEX) == 0 ){
+			if( (element % trailer.stride) == 0 ){
+				offsets[n++] = child - pos;
+			}
+			element++;
+		}
+
+		if( (n == sizeof(offsets)/sizeof(u32)) || ((next >= end) && n) ){
+			if( (son_local_phy_lseek_set(h, table) < 0) ||
+					(son_phy_write(&(h->phy), offsets, n*sizeof(u32)) != (int)(n*sizeof(u32))) ){
+				h->err = SON_ERR_WRITE_IO;
+				return -1;
+			}
+			table += n*sizeof(u32);
+			n = 0;
+		}
+
+		child = next;
+	}
+
+	if( (son_local_phy_lseek_set(h, table) < 0) ||
+			(son_phy_write(&(h->phy), &trailer, sizeof(trailer)) != sizeof(trailer)) ){
+		h->err = SON_ERR_WRITE_IO;
+		return -1;
+	}
+
+	return table + sizeof(trailer);
+}